@@ -0,0 +1,553 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#include <psapi.h>
+#endif
+#include "simvarDefs.h"
+#include "sessions.h"
+#include "varLayout.h"
+#include "deltaDecoder.h"
+
+// Pretends to be a number of panels all polling the data link so we can
+// see how many panels it can serve, at what rates and how quickly it
+// answers. Start the data link first (replaying a recording gives the
+// same load every time, see README.md) and then run e.g.
+//
+//   idl-loadgen --instrument 4 --autopilot 4 --radio 2 --lights 2 --rate 30 --burst 20
+//
+// Each panel has its own socket so the data link gives each one its own
+// session (it can serve MaxSessions). A panel only ever has one request
+// outstanding. If no reply has arrived by the time it is due to poll
+// again the request is counted as lost.
+//
+// Pass --rss-every to sample the data link's memory while it runs, e.g.
+// to show it stays flat over hours of replayed flight (see loadTest.sh).
+const int PanelTypes = 4;
+const int MaxPanels = 64;
+const int MaxReplySize = 65536;
+
+struct LoadPanel {
+    PANEL_TYPE panelType;
+    SOCKET sockfd;
+    long dataSize;
+    SimVars vars;
+    long frameNo;
+    LONGLONG sentTime;      // When the outstanding request was sent (0 = none)
+    ULONGLONG nextPoll;
+    ULONGLONG nextBurst;
+    bool spinUp;
+};
+
+struct LoadStats {
+    long requests;
+    long replies;
+    long fulls;
+    long deltas;
+    long badReplies;
+    long lost;
+    long writes;
+    long long bytesIn;
+    std::vector<double> latencyMicros;
+};
+
+char host[64] = "127.0.0.1";
+int port = 52020;
+int panelCounts[PanelTypes] = { 1, 0, 0, 0 };
+double pollRate = 30;
+bool deltaV2 = false;
+int burstWrites = 0;
+DWORD burstMillis = 1000;
+int runSecs = 10;
+int serverPid = 0;
+int rssSecs = 0;
+
+LoadPanel panels[MaxPanels];
+int panelCount = 0;
+LoadStats stats;
+long firstRssKB = -1;
+long lastRssKB = -1;
+long maxRssKB = -1;
+double ticksPerMicro = 1;
+char reply[MaxReplySize];
+
+LONGLONG now()
+{
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    return count.QuadPart;
+}
+
+/// <summary>
+/// Total CPU time the process has used in secs or -1 if it can't be read.
+/// </summary>
+double processCpuSecs(int pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process) {
+        return -1;
+    }
+
+    FILETIME created, exited, kernel, user;
+    BOOL ok = GetProcessTimes(process, &created, &exited, &kernel, &user);
+    CloseHandle(process);
+    if (!ok) {
+        return -1;
+    }
+
+    ULARGE_INTEGER kernelTime, userTime;
+    kernelTime.LowPart = kernel.dwLowDateTime;
+    kernelTime.HighPart = kernel.dwHighDateTime;
+    userTime.LowPart = user.dwLowDateTime;
+    userTime.HighPart = user.dwHighDateTime;
+    return (kernelTime.QuadPart + userTime.QuadPart) / 10000000.0;
+#else
+    char path[64];
+    sprintf_s(path, "/proc/%d/stat", pid);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    char buf[1024];
+    size_t size = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    buf[size] = '\0';
+
+    // Process name is in brackets and may contain spaces
+    char* pos = strrchr(buf, ')');
+    unsigned long userTicks, systemTicks;
+    if (!pos || sscanf(pos + 2, "%*c %*d %*d %*d %*d %*d %*u %*lu %*lu %*lu %*lu %lu %lu", &userTicks, &systemTicks) != 2) {
+        return -1;
+    }
+
+    return (userTicks + systemTicks) / (double)sysconf(_SC_CLK_TCK);
+#endif
+}
+
+/// <summary>
+/// Resident memory of the process in KB or -1 if it can't be read.
+/// </summary>
+long processRssKB(int pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process) {
+        return -1;
+    }
+
+    PROCESS_MEMORY_COUNTERS counters;
+    BOOL ok = GetProcessMemoryInfo(process, &counters, sizeof(counters));
+    CloseHandle(process);
+    if (!ok) {
+        return -1;
+    }
+
+    return (long)(counters.WorkingSetSize / 1024);
+#else
+    char path[64];
+    sprintf_s(path, "/proc/%d/status", pid);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    char line[256];
+    long rssKB = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmRSS: %ld kB", &rssKB) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+
+    return rssKB;
+#endif
+}
+
+void sampleRss(ULONGLONG elapsedMillis)
+{
+    long rssKB = processRssKB(serverPid);
+    if (rssKB < 0) {
+        return;
+    }
+
+    if (firstRssKB < 0) {
+        firstRssKB = rssKB;
+    }
+    lastRssKB = rssKB;
+    if (rssKB > maxRssKB) {
+        maxRssKB = rssKB;
+    }
+
+    printf("%6llu secs: server RSS %ld KB\n", elapsedMillis / 1000, rssKB);
+    fflush(stdout);
+}
+
+bool addPanels(PANEL_TYPE panelType, int count, sockaddr_in* serverAddr)
+{
+    for (int i = 0; i < count; i++) {
+        if (panelCount == MaxPanels) {
+            printf("Too many panels (max %d)\n", MaxPanels);
+            return false;
+        }
+
+        LoadPanel* panel = &panels[panelCount];
+        panel->sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (panel->sockfd == INVALID_SOCKET) {
+            printf("Failed to create socket\n");
+            return false;
+        }
+
+        // So recv only sees replies from the data link
+        if (connect(panel->sockfd, (SOCKADDR*)serverAddr, sizeof(*serverAddr)) == SOCKET_ERROR) {
+            printf("Failed to connect socket to %s:%d\n", host, port);
+            return false;
+        }
+
+        panel->panelType = panelType;
+        panel->dataSize = panelDataSize(panelType);
+        panel->frameNo = 0;
+        panel->sentTime = 0;
+        panel->nextPoll = 0;
+        panel->nextBurst = 0;
+        panel->spinUp = true;
+        memset(&panel->vars, 0, sizeof(panel->vars));
+        panelCount++;
+    }
+
+    return true;
+}
+
+void sendRequest(LoadPanel* panel)
+{
+    Request request;
+    memset(&request, 0, sizeof(request));
+    request.requestedSize = panel->dataSize;
+    request.wantFullData = REQUEST_DELTA;
+    if (deltaV2) {
+        request.wantFullData |= DeltaFormatV2;
+    }
+
+    if (panel->sentTime != 0) {
+        stats.lost++;
+    }
+
+    panel->sentTime = now();
+    if (send(panel->sockfd, (char*)&request, sizeof(request), 0) == sizeof(request)) {
+        stats.requests++;
+    }
+}
+
+/// <summary>
+/// Spin the altitude encoder one way and then the other so the
+/// aircraft ends up where it started.
+/// </summary>
+void sendBurst(LoadPanel* panel)
+{
+    Request request;
+    memset(&request, 0, sizeof(request));
+    request.requestedSize = sizeof(WriteData);
+    request.writeData.eventId = panel->spinUp ? KEY_AP_ALT_VAR_INC : KEY_AP_ALT_VAR_DEC;
+    request.writeData.value = 0;
+    panel->spinUp = !panel->spinUp;
+
+    for (int i = 0; i < burstWrites; i++) {
+        if (send(panel->sockfd, (char*)&request, sizeof(request), 0) == sizeof(request)) {
+            stats.writes++;
+        }
+    }
+}
+
+void receiveReply(LoadPanel* panel)
+{
+    int bytes = recv(panel->sockfd, reply, sizeof(reply), 0);
+    if (bytes <= 0) {
+        return;
+    }
+
+    stats.bytesIn += bytes;
+    if (panel->sentTime != 0) {
+        stats.latencyMicros.push_back((now() - panel->sentTime) / ticksPerMicro);
+        panel->sentTime = 0;
+    }
+    stats.replies++;
+
+    bool isValid;
+    if (bytes == panel->dataSize) {
+        memcpy(&panel->vars, reply, bytes);
+        stats.fulls++;
+        isValid = true;
+    }
+    else if (bytes == sizeof(int)) {
+        // Data link says we asked for the wrong size
+        isValid = false;
+    }
+    else {
+        if (deltaV2) {
+            isValid = applyDeltaV2(reply, bytes, &panel->vars, &panel->frameNo);
+        }
+        else {
+            isValid = applyDelta(reply, bytes, &panel->vars);
+        }
+        stats.deltas++;
+    }
+
+    if (!isValid) {
+        stats.badReplies++;
+    }
+}
+
+double percentile(std::vector<double>* sorted, double fraction)
+{
+    if (sorted->empty()) {
+        return 0;
+    }
+
+    size_t index = (size_t)(fraction * sorted->size());
+    if (index >= sorted->size()) {
+        index = sorted->size() - 1;
+    }
+    return (*sorted)[index];
+}
+
+void showResults(double elapsedSecs, double serverCpuSecs)
+{
+    printf("Panels: %d instrument, %d autopilot, %d radio, %d lights polling at %g/sec (%s deltas)\n",
+        panelCounts[INSTRUMENT_PANEL], panelCounts[AUTOPILOT_PANEL], panelCounts[RADIO_PANEL], panelCounts[LIGHTS_PANEL],
+        pollRate, deltaV2 ? "v2" : "v1");
+    printf("Requests: %ld (%.0f/sec), %ld lost\n", stats.requests, stats.requests / elapsedSecs, stats.lost);
+    printf("Replies: %ld (%.0f/sec), %ld full, %ld delta, %ld bad, %.1f KB/sec\n", stats.replies, stats.replies / elapsedSecs,
+        stats.fulls, stats.deltas, stats.badReplies, stats.bytesIn / elapsedSecs / 1024);
+    if (burstWrites > 0) {
+        printf("Writes: %ld (%.0f/sec) in bursts of %d\n", stats.writes, stats.writes / elapsedSecs, burstWrites);
+    }
+
+    std::vector<double>* latencies = &stats.latencyMicros;
+    std::sort(latencies->begin(), latencies->end());
+    printf("Latency: p50 = %.0f us, p99 = %.0f us, p999 = %.0f us, max = %.0f us\n",
+        percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+        latencies->empty() ? 0 : latencies->back());
+
+    if (serverCpuSecs >= 0) {
+        printf("Server CPU: %.1f%%\n", serverCpuSecs * 100 / elapsedSecs);
+    }
+
+    if (firstRssKB >= 0) {
+        printf("Server RSS: first %ld KB, last %ld KB, max %ld KB\n", firstRssKB, lastRssKB, maxRssKB);
+    }
+}
+
+/// <summary>
+/// Poll and burst at the configured rates until the time is up,
+/// reading replies whenever nothing else is due.
+/// </summary>
+void run()
+{
+    DWORD pollMillis = (DWORD)(1000 / pollRate);
+    ULONGLONG start = GetTickCount64();
+    ULONGLONG end = start + runSecs * 1000ULL;
+    ULONGLONG nextRss = rssSecs > 0 ? start : end;
+
+    for (int i = 0; i < panelCount; i++) {
+        // Spread the panels out like real ones would be
+        panels[i].nextPoll = start + (pollMillis * i) / panelCount;
+        panels[i].nextBurst = start + burstMillis;
+    }
+
+    while (true) {
+        ULONGLONG time = GetTickCount64();
+        if (time >= end) {
+            break;
+        }
+
+        if (time >= nextRss) {
+            sampleRss(time - start);
+            nextRss += rssSecs * 1000ULL;
+        }
+
+        ULONGLONG nextDue = nextRss < end ? nextRss : end;
+        for (int i = 0; i < panelCount; i++) {
+            LoadPanel* panel = &panels[i];
+
+            if (time >= panel->nextPoll) {
+                sendRequest(panel);
+                panel->nextPoll += pollMillis;
+                if (panel->nextPoll <= time) {
+                    // Fallen behind so don't try to catch up
+                    panel->nextPoll = time + pollMillis;
+                }
+            }
+
+            if (burstWrites > 0 && panel->panelType == AUTOPILOT_PANEL && time >= panel->nextBurst) {
+                sendBurst(panel);
+                panel->nextBurst = time + burstMillis;
+            }
+
+            if (panel->nextPoll < nextDue) {
+                nextDue = panel->nextPoll;
+            }
+            if (burstWrites > 0 && panel->panelType == AUTOPILOT_PANEL && panel->nextBurst < nextDue) {
+                nextDue = panel->nextBurst;
+            }
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        SOCKET maxSock = 0;
+        for (int i = 0; i < panelCount; i++) {
+            FD_SET(panels[i].sockfd, &readable);
+            if (panels[i].sockfd > maxSock) {
+                maxSock = panels[i].sockfd;
+            }
+        }
+
+        time = GetTickCount64();
+        DWORD waitMillis = nextDue > time ? (DWORD)(nextDue - time) : 0;
+        timeval timeout;
+        timeout.tv_sec = waitMillis / 1000;
+        timeout.tv_usec = (waitMillis % 1000) * 1000;
+
+        if (select((int)maxSock + 1, &readable, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+
+        for (int i = 0; i < panelCount; i++) {
+            if (FD_ISSET(panels[i].sockfd, &readable)) {
+                receiveReply(&panels[i]);
+            }
+        }
+    }
+
+    if (rssSecs > 0) {
+        sampleRss(GetTickCount64() - start);
+    }
+}
+
+bool parseArgs(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--v2") == 0) {
+            deltaV2 = true;
+            continue;
+        }
+
+        if (i + 1 == argc) {
+            return false;
+        }
+        const char* arg = argv[i];
+        const char* val = argv[++i];
+
+        if (strcmp(arg, "--host") == 0) {
+            strncpy(host, val, sizeof(host) - 1);
+        }
+        else if (strcmp(arg, "--port") == 0) {
+            port = atoi(val);
+        }
+        else if (strcmp(arg, "--instrument") == 0) {
+            panelCounts[INSTRUMENT_PANEL] = atoi(val);
+        }
+        else if (strcmp(arg, "--autopilot") == 0) {
+            panelCounts[AUTOPILOT_PANEL] = atoi(val);
+        }
+        else if (strcmp(arg, "--radio") == 0) {
+            panelCounts[RADIO_PANEL] = atoi(val);
+        }
+        else if (strcmp(arg, "--lights") == 0) {
+            panelCounts[LIGHTS_PANEL] = atoi(val);
+        }
+        else if (strcmp(arg, "--rate") == 0) {
+            pollRate = atof(val);
+        }
+        else if (strcmp(arg, "--burst") == 0) {
+            burstWrites = atoi(val);
+        }
+        else if (strcmp(arg, "--burst-every") == 0) {
+            burstMillis = atoi(val);
+        }
+        else if (strcmp(arg, "--secs") == 0) {
+            runSecs = atoi(val);
+        }
+        else if (strcmp(arg, "--server-pid") == 0) {
+            serverPid = atoi(val);
+        }
+        else if (strcmp(arg, "--rss-every") == 0) {
+            rssSecs = atoi(val);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return pollRate > 0 && pollRate <= 1000 && runSecs > 0 && rssSecs >= 0 && (rssSecs == 0 || serverPid != 0);
+}
+
+int main(int argc, char* argv[])
+{
+    if (!parseArgs(argc, argv)) {
+        printf("Usage: idl-loadgen [--host addr] [--port n] [--instrument n] [--autopilot n] [--radio n] [--lights n]\n");
+        printf("         [--rate polls/sec] [--v2] [--burst writes] [--burst-every millis] [--secs n] [--server-pid pid]\n");
+        printf("         [--rss-every secs]\n");
+        printf("  Autopilot panels send a burst of encoder writes every burst-every millis (default 1000)\n");
+        printf("  Sampling the server's memory with --rss-every needs --server-pid\n");
+        return 2;
+    }
+
+    // Needed by the v2 delta decoder
+    if (!varLayoutInit()) {
+        return 2;
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        printf("Failed to initialise Windows Sockets\n");
+        return 2;
+    }
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    ticksPerMicro = freq.QuadPart / 1000000.0;
+
+    sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = inet_addr(host);
+
+    for (int panelType = 0; panelType < PanelTypes; panelType++) {
+        if (!addPanels((PANEL_TYPE)panelType, panelCounts[panelType], &serverAddr)) {
+            return 2;
+        }
+    }
+
+    if (panelCount > MaxSessions) {
+        printf("Warning: The data link can only give %d panels their own session\n", MaxSessions);
+    }
+
+    double serverCpuStart = serverPid ? processCpuSecs(serverPid) : -1;
+    ULONGLONG start = GetTickCount64();
+
+    run();
+
+    double elapsedSecs = (GetTickCount64() - start) / 1000.0;
+    double serverCpuSecs = -1;
+    if (serverCpuStart >= 0) {
+        double serverCpuEnd = processCpuSecs(serverPid);
+        if (serverCpuEnd >= 0) {
+            serverCpuSecs = serverCpuEnd - serverCpuStart;
+        }
+    }
+
+    showResults(elapsedSecs, serverCpuSecs);
+
+    for (int i = 0; i < panelCount; i++) {
+        closesocket(panels[i].sockfd);
+    }
+    WSACleanup();
+
+    // Fail if the data link isn't answering properly
+    return stats.replies > 0 && stats.badReplies == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Runs the data link replaying a recording and measures it with a load
+# of panels, e.g. after building with CMake into build/:
+#
+#   bench/loadTest.sh build flight.rec --instrument 4 --autopilot 4 --burst 20
+#
+# If the recording doesn't exist a short one is made from the fake sim
+# first. Anything after the recording is passed on to idl-loadgen. Exits
+# non-zero if the data link didn't answer properly.
+#
+# Set SPEED to change the replay speed (0 = as fast as possible). Looping
+# a recording flat out while sampling memory is a soak test, e.g. this
+# replays many hours of flight in an hour and shows the server's RSS:
+#
+#   SPEED=0 bench/loadTest.sh build flight.rec --instrument 4 --secs 3600 --rss-every 60
+if [ $# -lt 2 ]; then
+    echo "Usage: loadTest.sh build-dir recording [idl-loadgen args]"
+    exit 2
+fi
+
+BUILD=$1
+RECORDING=$2
+SPEED=${SPEED:-1}
+shift 2
+
+if [ ! -f "$RECORDING" ]; then
+    echo "Recording $RECORDING from the fake sim"
+    FAKESIM_AIRCRAFT=${FAKESIM_AIRCRAFT:-"Airbus A310"} timeout 30 "$BUILD/instrument-data-link" --record "$RECORDING" > /dev/null
+fi
+
+SERVER_LOG=$(mktemp)
+"$BUILD/instrument-data-link" --replay "$RECORDING" --speed "$SPEED" --loop > "$SERVER_LOG" &
+SERVER=$!
+
+# Give it time to start listening
+sleep 1
+
+"$BUILD/idl-loadgen" --server-pid $SERVER "$@"
+RESULT=$?
+
+kill $SERVER
+wait $SERVER 2> /dev/null
+
+# How much flight the server got through
+grep "hours of flight" "$SERVER_LOG" | tail -1
+rm -f "$SERVER_LOG"
+exit $RESULT
@@ -0,0 +1,1012 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include "simvarDefs.h"
+#include "varLayout.h"
+#include "diffKernel.h"
+#include "deltas.h"
+#include "framePublish.h"
+#include "jetbridge.h"
+#include "aircraft.h"
+#include "flightState.h"
+#include "flightRecorder.h"
+#include "SimConnect.h"
+
+extern const char* SimVarDefs[][2];
+
+// Times the functions on the hot path so every performance change has
+// a baseline to be measured against. Frames and Jetbridge replies come
+// from a recording if one is given (see flightRecorder.h), otherwise
+// they are made up with the given share of vars changing each frame.
+//
+//   idl-microbench [--recording file] [--change percent] [--filter name] [--millis n]
+//
+// The var layout is shown first as adding vars to SimVarDefs makes most
+// of these slower.
+const int MaxBenchFrames = 1024;
+const int SyntheticFrames = 256;
+const int SyntheticPasses = 32;
+
+struct Benchmark {
+    const char* name;
+    void (*run)(long iterations);
+};
+
+// The data link would normally provide these
+SimVars simVars;
+
+std::vector<SimVars> benchFrames;
+std::vector<std::string> a310Replies;
+std::vector<std::string> fbwReplies;
+std::vector<std::string> replyValues;
+std::vector<std::string> a310BaselineReplies;
+std::vector<std::string> fbwBaselineReplies;
+char recordedAircraft[32] = "";
+SimVars recordVars;
+long skippedMessages = 0;
+
+int changePercent = 10;
+DWORD minMillis = 200;
+const char* filter = NULL;
+unsigned int seed = 1;
+volatile double benchSink;
+
+static unsigned int nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+static double* varDouble(SimVars* vars, VarLayout* var)
+{
+    return (double*)((char*)vars + var->offset);
+}
+
+/// <summary>
+/// Frames where roughly changePercent of the numeric vars move each time.
+/// </summary>
+void makeFrames()
+{
+    SimVars vars;
+    memset(&vars, 0, sizeof(vars));
+    vars.connected = 1;
+    strcpy(vars.aircraft, "Airbus A310");
+
+    for (int i = 0; i < varCount; i++) {
+        if (varLayout[i].kind == VAR_DOUBLE) {
+            *varDouble(&vars, &varLayout[i]) = i * 1.5;
+        }
+    }
+
+    for (int frame = 0; frame < SyntheticFrames; frame++) {
+        for (int i = 0; i < varCount; i++) {
+            VarLayout* var = &varLayout[i];
+            if (var->kind == VAR_DOUBLE && (int)(nextRandom() % 100) < changePercent) {
+                *varDouble(&vars, var) += (nextRandom() % 2000) / 10.0 - 100;
+            }
+        }
+        benchFrames.push_back(vars);
+    }
+}
+
+/// <summary>
+/// Unpacks var data the same way the data link does when it isn't
+/// using tagged data.
+/// </summary>
+void unpackData(SIMCONNECT_RECV_SIMOBJECT_DATA* pObjData)
+{
+    if (pObjData->dwFlags & SIMCONNECT_DATA_REQUEST_FLAG_TAGGED) {
+        skippedMessages++;
+        return;
+    }
+
+    const char* data = (const char*)&pObjData->dwData;
+    const char* end = (const char*)pObjData + pObjData->dwSize;
+
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        if (var->rate != (VAR_RATE)pObjData->dwRequestID || (var->kind != VAR_DOUBLE && var->kind != VAR_STRING32)) {
+            continue;
+        }
+
+        if (data + var->size > end) {
+            skippedMessages++;
+            return;
+        }
+        memcpy((char*)&recordVars + var->offset, data, var->size);
+        data += var->size;
+    }
+
+    if (pObjData->dwRequestID == RATE_FRAME && benchFrames.size() < MaxBenchFrames) {
+        recordVars.connected = 1;
+        benchFrames.push_back(recordVars);
+        strncpy(recordedAircraft, recordVars.aircraft, sizeof(recordedAircraft) - 1);
+    }
+}
+
+void CALLBACK collectRecorded(SIMCONNECT_RECV* pData, DWORD cbData, void* pContext)
+{
+    if (pData->dwID == SIMCONNECT_RECV_ID_SIMOBJECT_DATA) {
+        unpackData((SIMCONNECT_RECV_SIMOBJECT_DATA*)pData);
+    }
+    else if (pData->dwID == SIMCONNECT_RECV_ID_CLIENT_DATA) {
+        jetbridge::Packet* packet = (jetbridge::Packet*)&((SIMCONNECT_RECV_CLIENT_DATA*)pData)->dwData;
+        std::string reply(packet->data, strnlen(packet->data, jetbridge::kPacketDataSize));
+        if (strstr(recordedAircraft, "A310")) {
+            a310Replies.push_back(reply);
+        }
+        else {
+            fbwReplies.push_back(reply);
+        }
+    }
+}
+
+bool loadRecording(const char* filename)
+{
+    HANDLE event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    memset(&recordVars, 0, sizeof(recordVars));
+
+    if (!replayOpen(filename, 0, event)) {
+        CloseHandle(event);
+        return false;
+    }
+
+    while (replayDispatch(collectRecorded) >= 0) {
+    }
+
+    replayClose();
+    CloseHandle(event);
+
+    if (skippedMessages > 0) {
+        printf("Skipped %ld messages (tagged data isn't supported)\n", skippedMessages);
+    }
+    return !benchFrames.empty();
+}
+
+std::vector<std::string>* collectList;
+
+void CALLBACK collectReplies(SIMCONNECT_RECV* pData, DWORD cbData, void* pContext)
+{
+    if (pData->dwID == SIMCONNECT_RECV_ID_CLIENT_DATA) {
+        jetbridge::Packet* packet = (jetbridge::Packet*)&((SIMCONNECT_RECV_CLIENT_DATA*)pData)->dwData;
+        collectList->push_back(std::string(packet->data, strnlen(packet->data, jetbridge::kPacketDataSize)));
+    }
+}
+
+/// <summary>
+/// Gets the fake sim to answer every read in the batch and then makes
+/// a number of passes where changePercent of the values change.
+/// </summary>
+void makeReplies(HANDLE hSimConnect, void (*readBatch)(), std::vector<std::string>* replies)
+{
+    std::vector<std::string> zeros;
+    collectList = &zeros;
+    readBatch();
+    SimConnect_CallDispatch(hSimConnect, collectReplies, NULL);
+
+    std::vector<int> values(zeros.size(), 0);
+    for (int pass = 0; pass < SyntheticPasses; pass++) {
+        for (size_t i = 0; i < zeros.size(); i++) {
+            if ((int)(nextRandom() % 100) < changePercent) {
+                values[i] = 1 - values[i];
+            }
+
+            // Replace the 0 the fake sim puts on the end
+            std::string reply = zeros[i];
+            reply[reply.size() - 1] = '0' + values[i];
+            replies->push_back(reply);
+        }
+    }
+}
+
+// The strncmp/atof chains the data link used before reads were packed,
+// kept here so the packed reads have something to be measured against.
+// Each reply was the var's RPN code with the value on the end.
+const char* const BaselineA310Vars[] = {
+    A310_APU_MASTER_SW,
+    A310_APU_START,
+    A310_APU_START_AVAIL,
+    A310_APU_BLEED,
+    A310_ELEC_BAT1,
+    A310_ELEC_BAT2,
+    A310_SEATBELTS_SWITCH,
+    A310_BEACON_LIGHTS,
+    A310_LANDING_LIGHTS_L,
+    A310_TAXI_LIGHTS,
+    A310_TURNOFF_LIGHTS_L,
+    A310_NAV_LIGHTS,
+    A310_STROBES,
+    A310_PITCH_TRIM1,
+    A310_PITCH_TRIM2,
+    A310_TCAS_MODE,
+    A310_AP_AIRSPEED,
+    A310_AP_IS_MACH,
+    A310_AP_HEADING,
+    A310_AP_ALTITUDE,
+    A310_AP_VERTICALSPEED,
+    A310_AUTOBRAKE,
+    A310_FLIGHTDIRECTOR,
+    A310_AUTOPILOT,
+    A310_AUTOTHROTTLE,
+    A310_LOCALISER,
+    A310_APPROACH,
+    A310_ENG_IGNITION,
+    A310_HEADING_MODE,
+    A310_PITCH_MODE,
+    A310_GEAR_HANDLE,
+    A310_ILS_FREQUENCY,
+    A310_ILS_COURSE,
+    NULL
+};
+
+const char* const BaselineFbwVars[] = {
+    A32NX_APU_MASTER_SW,
+    A32NX_APU_START,
+    A32NX_APU_START_AVAIL,
+    A32NX_APU_BLEED,
+    A32NX_ELEC_BAT1,
+    A32NX_ELEC_BAT2,
+    A32NX_FLAPS_INDEX,
+    A32NX_PARK_BRAKE_POS,
+    A32NX_SPOILERS_HANDLE_POS,
+    A32NX_XPNDR_MODE,
+    A32NX_AUTOPILOT_1,
+    A32NX_AUTOPILOT_2,
+    A32NX_AUTOTHRUST,
+    A32NX_TCAS_MODE,
+    A32NX_MANAGED_SPEED,
+    A32NX_MANAGED_HEADING,
+    A32NX_MANAGED_ALTITUDE,
+    A32NX_LATERAL_MODE,
+    A32NX_VERTICAL_MODE,
+    A32NX_LOC_MODE,
+    A32NX_APPR_MODE,
+    A32NX_AUTOTHRUST_MODE,
+    A32NX_AUTOBRAKE,
+    A32NX_LEFT_BRAKEPEDAL,
+    A32NX_RIGHT_BRAKEPEDAL,
+    A32NX_RUDDER_PEDAL_POS,
+    A32NX_AUTOPILOT_HDG,
+    A32NX_AUTOPILOT_VS,
+    A32NX_AUTOPILOT_FPA,
+    A32NX_ENGINE_EGT1,
+    A32NX_ENGINE_EGT2,
+    A32NX_ENGINE_FUEL_FLOW1,
+    A32NX_ENGINE_FUEL_FLOW2,
+    NULL
+};
+
+void baselineA310Update(const char* data)
+{
+    if (strncmp(&data[1], A310_APU_MASTER_SW, sizeof(A310_APU_MASTER_SW) - 1) == 0) {
+        simVars.apuMasterSw = atof(&data[sizeof(A310_APU_MASTER_SW) + 1]);
+    }
+    else if (strncmp(&data[1], A310_APU_START, sizeof(A310_APU_START) - 1) == 0) {
+        a310Vars.apuStart = atof(&data[sizeof(A310_APU_START) + 1]);
+    }
+    else if (strncmp(&data[1], A310_APU_START_AVAIL, sizeof(A310_APU_START_AVAIL) - 1) == 0) {
+        a310Vars.apuStartAvail = atof(&data[sizeof(A310_APU_START_AVAIL) + 1]);
+    }
+    else if (strncmp(&data[1], A310_APU_BLEED, sizeof(A310_APU_BLEED) - 1) == 0) {
+        simVars.apuBleed = atof(&data[sizeof(A310_APU_BLEED) + 1]);
+    }
+    else if (strncmp(&data[1], A310_ELEC_BAT1, sizeof(A310_ELEC_BAT1) - 1) == 0) {
+        simVars.elecBat1 = atof(&data[sizeof(A310_ELEC_BAT1) + 1]);
+    }
+    else if (strncmp(&data[1], A310_ELEC_BAT2, sizeof(A310_ELEC_BAT2) - 1) == 0) {
+        simVars.elecBat2 = atof(&data[sizeof(A310_ELEC_BAT2) + 1]);
+    }
+    else if (strncmp(&data[1], A310_SEATBELTS_SWITCH, sizeof(A310_SEATBELTS_SWITCH) - 1) == 0) {
+        a310Vars.seatbeltsSwitch = atof(&data[sizeof(A310_SEATBELTS_SWITCH) + 1]);
+    }
+    else if (strncmp(&data[1], A310_BEACON_LIGHTS, sizeof(A310_BEACON_LIGHTS) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_BEACON_LIGHTS) + 1]) != a310Vars.beaconLights) {
+            writeJetbridgeVar(A310_BEACON_LIGHTS, a310Vars.beaconLights);
+        }
+    }
+    else if (strncmp(&data[1], A310_LANDING_LIGHTS_L, sizeof(A310_LANDING_LIGHTS_L) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_LANDING_LIGHTS_L) + 1]) != a310Vars.landingLights) {
+            writeJetbridgeVar(A310_LANDING_LIGHTS_L, a310Vars.landingLights);
+            writeJetbridgeVar(A310_LANDING_LIGHTS_R, a310Vars.landingLights);
+        }
+    }
+    else if (strncmp(&data[1], A310_TAXI_LIGHTS, sizeof(A310_TAXI_LIGHTS) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_TAXI_LIGHTS) + 1]) != a310Vars.taxiLights) {
+            writeJetbridgeVar(A310_TAXI_LIGHTS, a310Vars.taxiLights);
+        }
+    }
+    else if (strncmp(&data[1], A310_TURNOFF_LIGHTS_L, sizeof(A310_TURNOFF_LIGHTS_L) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_TURNOFF_LIGHTS_L) + 1]) != a310Vars.turnoffLights) {
+            writeJetbridgeVar(A310_TURNOFF_LIGHTS_L, a310Vars.turnoffLights);
+            writeJetbridgeVar(A310_TURNOFF_LIGHTS_R, a310Vars.turnoffLights);
+        }
+    }
+    else if (strncmp(&data[1], A310_NAV_LIGHTS, sizeof(A310_NAV_LIGHTS) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_NAV_LIGHTS) + 1]) != a310Vars.navLights) {
+            writeJetbridgeVar(A310_NAV_LIGHTS, a310Vars.navLights);
+        }
+    }
+    else if (strncmp(&data[1], A310_STROBES, sizeof(A310_STROBES) - 1) == 0) {
+        // Force to required value (doesn't always stick)
+        if (atof(&data[sizeof(A310_STROBES) + 1]) != a310Vars.strobes) {
+            writeJetbridgeVar(A310_STROBES, a310Vars.strobes);
+        }
+    }
+    else if (strncmp(&data[1], A310_PITCH_TRIM1, sizeof(A310_PITCH_TRIM1) - 1) == 0) {
+        a310Vars.pitchTrim1 = atof(&data[sizeof(A310_PITCH_TRIM1) + 1]);
+    }
+    else if (strncmp(&data[1], A310_PITCH_TRIM2, sizeof(A310_PITCH_TRIM2) - 1) == 0) {
+        a310Vars.pitchTrim2 = atof(&data[sizeof(A310_PITCH_TRIM2) + 1]);
+    }
+    else if (strncmp(&data[1], A310_TCAS_MODE, sizeof(A310_TCAS_MODE) - 1) == 0) {
+        simVars.jbTcasMode = atof(&data[sizeof(A310_TCAS_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AP_AIRSPEED, sizeof(A310_AP_AIRSPEED) - 1) == 0) {
+        a310Vars.autopilotAirspeed = atof(&data[sizeof(A310_AP_AIRSPEED) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AP_IS_MACH, sizeof(A310_AP_IS_MACH) - 1) == 0) {
+        simVars.jbShowMach = atof(&data[sizeof(A310_AP_IS_MACH) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AP_HEADING, sizeof(A310_AP_HEADING) - 1) == 0) {
+        a310Vars.autopilotHeading = atof(&data[sizeof(A310_AP_HEADING) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AP_ALTITUDE, sizeof(A310_AP_ALTITUDE) - 1) == 0) {
+        a310Vars.autopilotAltitude = atof(&data[sizeof(A310_AP_ALTITUDE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AP_VERTICALSPEED, sizeof(A310_AP_VERTICALSPEED) - 1) == 0) {
+        a310Vars.autopilotVerticalSpeed = atof(&data[sizeof(A310_AP_VERTICALSPEED) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AUTOBRAKE, sizeof(A310_AUTOBRAKE) - 1) == 0) {
+        simVars.jbAutobrake = atof(&data[sizeof(A310_AUTOBRAKE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_FLIGHTDIRECTOR, sizeof(A310_FLIGHTDIRECTOR) - 1) == 0) {
+        a310Vars.flightDirector = atof(&data[sizeof(A310_FLIGHTDIRECTOR) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AUTOPILOT, sizeof(A310_AUTOPILOT) - 1) == 0) {
+        a310Vars.autopilot = atof(&data[sizeof(A310_AUTOPILOT) + 1]);
+    }
+    else if (strncmp(&data[1], A310_AUTOTHROTTLE, sizeof(A310_AUTOTHROTTLE) - 1) == 0) {
+        a310Vars.autothrottle = atof(&data[sizeof(A310_AUTOTHROTTLE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_LOCALISER, sizeof(A310_LOCALISER) - 1) == 0) {
+        a310Vars.localiser = atof(&data[sizeof(A310_LOCALISER) + 1]);
+    }
+    else if (strncmp(&data[1], A310_APPROACH, sizeof(A310_APPROACH) - 1) == 0) {
+        a310Vars.approach = atof(&data[sizeof(A310_APPROACH) + 1]);
+    }
+    else if (strncmp(&data[1], A310_ENG_IGNITION, sizeof(A310_ENG_IGNITION) - 1) == 0) {
+        // 1 = Start A, 3 = Off
+        a310Vars.engineIgnition = atof(&data[sizeof(A310_ENG_IGNITION) + 1]);
+    }
+    else if (strncmp(&data[1], A310_HEADING_MODE, sizeof(A310_HEADING_MODE) - 1) == 0) {
+        simVars.jbManagedHeading = 1 - atof(&data[sizeof(A310_HEADING_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_PITCH_MODE, sizeof(A310_PITCH_MODE) - 1) == 0) {
+        // 7 & 8 = ALL OFF, 6 & 9 = Alt Hold, 2 & 4 = LVL/CH, 3 & 5 & 15 & 20 & 26 = PROFILE
+        a310Vars.pitchMode = atof(&data[sizeof(A310_PITCH_MODE) + 1]);
+        a310Vars.altHold = (a310Vars.pitchMode == 6 || a310Vars.pitchMode == 9);
+        a310Vars.levelChange = (a310Vars.pitchMode == 2 || a310Vars.pitchMode == 4);
+        a310Vars.profile = (!a310Vars.altHold && !a310Vars.levelChange && a310Vars.pitchMode != 7 && a310Vars.pitchMode != 8);
+    }
+    else if (strncmp(&data[1], A310_GEAR_HANDLE, sizeof(A310_GEAR_HANDLE) - 1) == 0) {
+        a310Vars.gearHandle = atof(&data[sizeof(A310_GEAR_HANDLE) + 1]);
+    }
+    else if (strncmp(&data[1], A310_ILS_FREQUENCY, sizeof(A310_ILS_FREQUENCY) - 1) == 0) {
+       a310Vars.ilsFrequency = atof(&data[sizeof(A310_ILS_FREQUENCY) + 1]);
+    }
+    else if (strncmp(&data[1], A310_ILS_COURSE, sizeof(A310_ILS_COURSE) - 1) == 0) {
+        a310Vars.ilsCourse = atof(&data[sizeof(A310_ILS_COURSE) + 1]);
+    }
+}
+
+void baselineFbwUpdate(const char* data)
+{
+    if (strncmp(&data[1], A32NX_APU_MASTER_SW, sizeof(A32NX_APU_MASTER_SW) - 1) == 0) {
+        simVars.apuMasterSw = atof(&data[sizeof(A32NX_APU_MASTER_SW) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_APU_START, sizeof(A32NX_APU_START) - 1) == 0) {
+        fbwVars.apuStart = atof(&data[sizeof(A32NX_APU_START) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_APU_START_AVAIL, sizeof(A32NX_APU_START_AVAIL) - 1) == 0) {
+        fbwVars.apuStartAvail = atof(&data[sizeof(A32NX_APU_START_AVAIL) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_APU_BLEED, sizeof(A32NX_APU_BLEED) - 1) == 0) {
+        simVars.apuBleed = atof(&data[sizeof(A32NX_APU_BLEED) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ELEC_BAT1, sizeof(A32NX_ELEC_BAT1) - 1) == 0) {
+        simVars.elecBat1 = atof(&data[sizeof(A32NX_ELEC_BAT1) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ELEC_BAT2, sizeof(A32NX_ELEC_BAT2) - 1) == 0) {
+        simVars.elecBat2 = atof(&data[sizeof(A32NX_ELEC_BAT2) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_FLAPS_INDEX, sizeof(A32NX_FLAPS_INDEX) - 1) == 0) {
+        fbwVars.flapsIndex = atof(&data[sizeof(A32NX_FLAPS_INDEX) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_PARK_BRAKE_POS, sizeof(A32NX_PARK_BRAKE_POS) - 1) == 0) {
+        fbwVars.parkBrakePos = atof(&data[sizeof(A32NX_PARK_BRAKE_POS) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_XPNDR_MODE, sizeof(A32NX_XPNDR_MODE) - 1) == 0) {
+        fbwVars.xpndrMode = atof(&data[sizeof(A32NX_XPNDR_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOPILOT_1, sizeof(A32NX_AUTOPILOT_1) - 1) == 0) {
+        fbwVars.autopilot1 = atof(&data[sizeof(A32NX_AUTOPILOT_1) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOPILOT_2, sizeof(A32NX_AUTOPILOT_2) - 1) == 0) {
+        fbwVars.autopilot2 = atof(&data[sizeof(A32NX_AUTOPILOT_2) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOTHRUST, sizeof(A32NX_AUTOTHRUST) - 1) == 0) {
+        fbwVars.autothrust = atof(&data[sizeof(A32NX_AUTOTHRUST) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_TCAS_MODE, sizeof(A32NX_TCAS_MODE) - 1) == 0) {
+        simVars.jbTcasMode = atof(&data[sizeof(A32NX_TCAS_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOPILOT_HDG, sizeof(A32NX_AUTOPILOT_HDG) - 1) == 0) {
+        fbwVars.autopilotHeading = atof(&data[sizeof(A32NX_AUTOPILOT_HDG) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOPILOT_VS, sizeof(A32NX_AUTOPILOT_VS) - 1) == 0) {
+        fbwVars.autopilotVerticalSpeed = atof(&data[sizeof(A32NX_AUTOPILOT_VS) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOPILOT_FPA, sizeof(A32NX_AUTOPILOT_FPA) - 1) == 0) {
+        fbwVars.autopilotFpa = atof(&data[sizeof(A32NX_AUTOPILOT_FPA) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_MANAGED_SPEED, sizeof(A32NX_MANAGED_SPEED) - 1) == 0) {
+        simVars.jbManagedSpeed = atof(&data[sizeof(A32NX_MANAGED_SPEED) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_MANAGED_HEADING, sizeof(A32NX_MANAGED_HEADING) - 1) == 0) {
+        simVars.jbManagedHeading = atof(&data[sizeof(A32NX_MANAGED_HEADING) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_MANAGED_ALTITUDE, sizeof(A32NX_MANAGED_ALTITUDE) - 1) == 0) {
+        simVars.jbManagedAltitude = atof(&data[sizeof(A32NX_MANAGED_ALTITUDE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_LATERAL_MODE, sizeof(A32NX_LATERAL_MODE) - 1) == 0) {
+        simVars.jbLateralMode = atof(&data[sizeof(A32NX_LATERAL_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_VERTICAL_MODE, sizeof(A32NX_VERTICAL_MODE) - 1) == 0) {
+        simVars.jbVerticalMode = atof(&data[sizeof(A32NX_VERTICAL_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_LOC_MODE, sizeof(A32NX_LOC_MODE) - 1) == 0) {
+        simVars.jbLocMode = atof(&data[sizeof(A32NX_LOC_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_APPR_MODE, sizeof(A32NX_APPR_MODE) - 1) == 0) {
+        simVars.jbApprMode = atof(&data[sizeof(A32NX_APPR_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOTHRUST_MODE, sizeof(A32NX_AUTOTHRUST_MODE) - 1) == 0) {
+        simVars.jbAutothrustMode = atof(&data[sizeof(A32NX_AUTOTHRUST_MODE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_AUTOBRAKE, sizeof(A32NX_AUTOBRAKE) - 1) == 0) {
+        simVars.jbAutobrake = atof(&data[sizeof(A32NX_AUTOBRAKE) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_LEFT_BRAKEPEDAL, sizeof(A32NX_LEFT_BRAKEPEDAL) - 1) == 0) {
+        fbwVars.leftBrakePedal = atof(&data[sizeof(A32NX_LEFT_BRAKEPEDAL) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_SPOILERS_HANDLE_POS, sizeof(A32NX_SPOILERS_HANDLE_POS) - 1) == 0) {
+        fbwVars.spoilersHandlePos = atof(&data[sizeof(A32NX_SPOILERS_HANDLE_POS) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_RIGHT_BRAKEPEDAL, sizeof(A32NX_RIGHT_BRAKEPEDAL) - 1) == 0) {
+        fbwVars.rightBrakePedal = atof(&data[sizeof(A32NX_RIGHT_BRAKEPEDAL) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_RUDDER_PEDAL_POS, sizeof(A32NX_RUDDER_PEDAL_POS) - 1) == 0) {
+        fbwVars.rudderPedalPos = atof(&data[sizeof(A32NX_RUDDER_PEDAL_POS) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ENGINE_EGT1, sizeof(A32NX_ENGINE_EGT1) - 1) == 0) {
+        fbwVars.engineEgt1 = atof(&data[sizeof(A32NX_ENGINE_EGT1) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ENGINE_EGT2, sizeof(A32NX_ENGINE_EGT2) - 1) == 0) {
+        fbwVars.engineEgt2 = atof(&data[sizeof(A32NX_ENGINE_EGT2) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ENGINE_FUEL_FLOW1, sizeof(A32NX_ENGINE_FUEL_FLOW1) - 1) == 0) {
+        fbwVars.engineFuelFlow1 = atof(&data[sizeof(A32NX_ENGINE_FUEL_FLOW1) + 1]);
+    }
+    else if (strncmp(&data[1], A32NX_ENGINE_FUEL_FLOW2, sizeof(A32NX_ENGINE_FUEL_FLOW2) - 1) == 0) {
+        fbwVars.engineFuelFlow2 = atof(&data[sizeof(A32NX_ENGINE_FUEL_FLOW2) + 1]);
+    }
+    else if (strncmp(data, "write", 5) != 0) {
+        printf("Uknown Fbw from Jetbridge: %s\n", data);
+    }
+}
+
+/// <summary>
+/// Where the value starts in a reply, found the same way the data link
+/// does when it can't match a reply by id.
+/// </summary>
+int replyValuePos(const std::string& reply)
+{
+    int valuePos = (int)reply.size();
+    while (valuePos > 0 && ((reply[valuePos - 1] >= '0' && reply[valuePos - 1] <= '9') || reply[valuePos - 1] == '.')) {
+        valuePos--;
+    }
+    if (valuePos > 0 && reply[valuePos - 1] == '-') {
+        valuePos--;
+    }
+    return valuePos;
+}
+
+/// <summary>
+/// One reply per var in the old format for each value, so both chains
+/// see the same values the packed reads do.
+/// </summary>
+void makeBaselineReplies(const char* const* vars, std::vector<std::string>* replies)
+{
+    size_t valueNo = 0;
+    for (int pass = 0; pass < SyntheticPasses; pass++) {
+        for (const char* const* var = vars; *var; var++) {
+            replies->push_back(std::string("(") + *var + ")" + replyValues[valueNo % replyValues.size()]);
+            valueNo++;
+        }
+    }
+}
+
+/// <summary>
+/// The fast path is only worth having if it gives the same answer as
+/// atof, so check every value before timing it.
+/// </summary>
+bool checkParseValue()
+{
+    int mismatches = 0;
+    for (const std::string& value : replyValues) {
+        double fast = parseJetbridgeValue(value.c_str());
+        double slow = atof(value.c_str());
+        if (memcmp(&fast, &slow, sizeof(double)) != 0) {
+            if (mismatches < 10) {
+                printf("parseJetbridgeValue(\"%s\") gave %.17g but atof gave %.17g\n", value.c_str(), fast, slow);
+            }
+            mismatches++;
+        }
+    }
+
+    if (mismatches > 0) {
+        printf("parseJetbridgeValue differs from atof for %d of %d values\n", mismatches, (int)replyValues.size());
+        return false;
+    }
+    return true;
+}
+
+void benchDiffKernel(long iterations)
+{
+    unsigned long long wordMask[WordMaskSize];
+    size_t count = benchFrames.size();
+
+    for (long i = 0; i < iterations; i++) {
+        diffWords((double*)&benchFrames[i % count], (double*)&benchFrames[(i + 1) % count], wordCount, wordMask);
+    }
+    benchSink = (double)wordMask[0];
+}
+
+void benchDiffScalar(long iterations)
+{
+    unsigned long long wordMask[WordMaskSize];
+    size_t count = benchFrames.size();
+
+    for (long i = 0; i < iterations; i++) {
+        diffWordsScalar((double*)&benchFrames[i % count], (double*)&benchFrames[(i + 1) % count], wordCount, wordMask);
+    }
+    benchSink = (double)wordMask[0];
+}
+
+void benchSnapshot(long iterations)
+{
+    size_t count = benchFrames.size();
+    deltasInit(&benchFrames[0]);
+
+    for (long i = 0; i < iterations; i++) {
+        snapshotFrame(&benchFrames[i % count]);
+    }
+    benchSink = latestFrame()->frameNo;
+}
+
+/// <summary>
+/// What sendDelta does for one panel of each type on every frame.
+/// </summary>
+void benchDeltaV1(long iterations)
+{
+    size_t count = benchFrames.size();
+    long deltaSize = 0;
+    deltasInit(&benchFrames[0]);
+
+    for (long i = 0; i < iterations; i++) {
+        long baseFrameNo = latestFrame()->frameNo;
+        snapshotFrame(&benchFrames[i % count]);
+        for (int panel = INSTRUMENT_PANEL; panel <= LIGHTS_PANEL; panel++) {
+            getDelta(baseFrameNo, (PANEL_TYPE)panel, &deltaSize);
+        }
+    }
+    benchSink = deltaSize;
+}
+
+void benchDeltaV2(long iterations)
+{
+    size_t count = benchFrames.size();
+    long deltaSize = 0;
+    deltasInit(&benchFrames[0]);
+
+    for (long i = 0; i < iterations; i++) {
+        long baseFrameNo = latestFrame()->frameNo;
+        snapshotFrame(&benchFrames[i % count]);
+        for (int panel = INSTRUMENT_PANEL; panel <= LIGHTS_PANEL; panel++) {
+            getDeltaV2(baseFrameNo, (PANEL_TYPE)panel, &deltaSize);
+        }
+    }
+    benchSink = deltaSize;
+}
+
+// What sendDelta did before frames were snapshotted, i.e. a compare of
+// every var against the copy of what was last sent to the panel, kept
+// so the snapshots have something to be measured against. Only the
+// sendto is left out.
+const int deltaDoubleSize = sizeof(DeltaDouble);
+const int deltaStringSize = sizeof(DeltaString);
+
+char baselineDeltaData[sizeof(SimVars) * 2];
+long baselineDeltaSize = 0;
+char baselinePrevData[LIGHTS_PANEL + 1][sizeof(SimVars)];
+
+void addDeltaDouble(long offset, double newVal)
+{
+    DeltaDouble deltaDouble;
+    deltaDouble.offset = offset;
+    deltaDouble.data = newVal;
+
+    memcpy(baselineDeltaData + baselineDeltaSize, &deltaDouble, deltaDoubleSize);
+    baselineDeltaSize += deltaDoubleSize;
+}
+
+void addDeltaString(long offset, const char *newVal)
+{
+    DeltaString deltaString;
+    deltaString.offset = 0x10000 | offset;  // Set high bit so we know it is a string
+    strncpy(deltaString.data, newVal, 32);  // Only support string32
+
+    memcpy(baselineDeltaData + baselineDeltaSize, &deltaString, deltaStringSize);
+    baselineDeltaSize += deltaStringSize;
+}
+
+void baselineSendDelta(const SimVars* vars, char* prevSimVars, long dataSize)
+{
+    // Initialise delta data
+    baselineDeltaSize = 0;
+
+    // Always send 'connected' var
+    addDeltaDouble(0, vars->connected);
+    long offset = sizeof(double);
+
+    // Add all vars that have changed to delta data
+    for (int i = 0;; i++) {
+        if (SimVarDefs[i][0] == NULL) {
+            break;
+        }
+
+        char* oldVarPtr = prevSimVars + offset;
+        const char* newVarPtr = (const char*)vars + offset;
+
+        if (_strnicmp(SimVarDefs[i][1], "string", 6) == 0) {
+            // Has string changed?
+            if (strncmp(oldVarPtr, newVarPtr, 32) != 0) {
+                addDeltaString(offset, newVarPtr);
+                memcpy(oldVarPtr, newVarPtr, 32);
+            }
+
+            offset += 32;
+        }
+        else {
+            // Has double changed?
+            double* oldVar = (double*)oldVarPtr;
+            const double* newVar = (const double*)newVarPtr;
+            if (*oldVar != *newVar) {
+                addDeltaDouble(offset, *newVar);
+                memcpy(oldVarPtr, newVarPtr, sizeof(double));
+            }
+
+            offset += 8;
+        }
+
+        // Next variable
+        if (offset >= dataSize) {
+            break;
+        }
+    }
+}
+
+void benchDeltaBaseline(long iterations)
+{
+    size_t count = benchFrames.size();
+    for (int panel = INSTRUMENT_PANEL; panel <= LIGHTS_PANEL; panel++) {
+        memcpy(baselinePrevData[panel], &benchFrames[0], sizeof(SimVars));
+    }
+
+    for (long i = 0; i < iterations; i++) {
+        for (int panel = INSTRUMENT_PANEL; panel <= LIGHTS_PANEL; panel++) {
+            baselineSendDelta(&benchFrames[i % count], baselinePrevData[panel], panelDataSize((PANEL_TYPE)panel));
+        }
+    }
+    benchSink = baselineDeltaSize;
+}
+
+/// <summary>
+/// Everything sendFull needs before it can send, i.e. the frame being
+/// published by the SimConnect thread and taken by the server.
+/// </summary>
+void benchPublish(long iterations)
+{
+    size_t count = benchFrames.size();
+    publishInit(&benchFrames[0]);
+
+    for (long i = 0; i < iterations; i++) {
+        publishFrame(&benchFrames[i % count], NULL);
+        benchSink = takeFrame(NULL)->vars.connected;
+    }
+}
+
+void benchA310Replies(long iterations)
+{
+    size_t count = a310Replies.size();
+    for (long i = 0; i < iterations; i++) {
+        updateA310FromJetbridge(a310Replies[i % count].c_str());
+    }
+}
+
+void benchFbwReplies(long iterations)
+{
+    size_t count = fbwReplies.size();
+    for (long i = 0; i < iterations; i++) {
+        updateFbwFromJetbridge(fbwReplies[i % count].c_str());
+    }
+}
+
+void benchA310Baseline(long iterations)
+{
+    size_t count = a310BaselineReplies.size();
+    for (long i = 0; i < iterations; i++) {
+        baselineA310Update(a310BaselineReplies[i % count].c_str());
+    }
+}
+
+void benchFbwBaseline(long iterations)
+{
+    size_t count = fbwBaselineReplies.size();
+    for (long i = 0; i < iterations; i++) {
+        baselineFbwUpdate(fbwBaselineReplies[i % count].c_str());
+    }
+}
+
+void benchAtof(long iterations)
+{
+    size_t count = replyValues.size();
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += atof(replyValues[i % count].c_str());
+    }
+    benchSink = sum;
+}
+
+void benchParseValue(long iterations)
+{
+    size_t count = replyValues.size();
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += parseJetbridgeValue(replyValues[i % count].c_str());
+    }
+    benchSink = sum;
+}
+
+void benchWriteFormat(long iterations)
+{
+    RpnProgram program = {};
+    for (long i = 0; i < iterations; i++) {
+        if (i % 4 == 0) {
+            program.codeLen = 0;
+        }
+        writeJetbridgeVar(&program, A310_APU_MASTER_SW, (double)(i & 1));
+        writeJetbridgeVar(&program, KEY_AP_ALT_VAR_SET_ENGLISH, 10000 + (i % 100) * 100);
+    }
+    benchSink = program.codeLen;
+}
+
+void benchWriteSend(long iterations)
+{
+    for (long i = 0; i < iterations; i++) {
+        writeJetbridgeVar(KEY_HEADING_BUG_SET, (double)(i % 360));
+    }
+}
+
+void benchDetectAircraft(long iterations)
+{
+    const char* titles[] = { "Airbus A310-300", "Airbus A310-300", "Airbus A310-300", "FlyByWire A320neo", "Boeing 747-8i", "Cessna 152" };
+    const int titleCount = sizeof(titles) / sizeof(titles[0]);
+
+    for (long i = 0; i < iterations; i++) {
+        detectAircraft(titles[(i / 64) % titleCount]);
+    }
+    benchSink = isA310;
+}
+
+struct PhaseState {
+    double altAboveGround;
+    double altAltitude;
+    double verticalSpeed;
+    double parkingBrakeOn;
+    double pushbackState;
+    bool completedTakeOff;
+};
+
+// One of each flight phase. Arriving at the stand is left out as it
+// resets the flight.
+const PhaseState PhaseStates[] = {
+    { 0, 100, 0, 1, 3, false },             // On stand
+    { 0, 100, 0, 0, 0, false },             // Pushing back
+    { 2000, 3000, 10, 0, 3, false },        // Takeoff
+    { 20000, 20000, 10, 0, 3, true },       // Climb
+    { 35000, 35000, 0, 0, 3, true },        // Cruise
+    { 20000, 20000, -10, 0, 3, true },      // Descent
+    { 3000, 3000, -5, 0, 3, true },         // Approach
+    { 0, 100, 0, 0, 3, true }               // Taxi in
+};
+
+void benchCustomEvent(long iterations)
+{
+    const int phaseCount = sizeof(PhaseStates) / sizeof(PhaseStates[0]);
+    int sum = 0;
+
+    for (long i = 0; i < iterations; i++) {
+        const PhaseState* state = &PhaseStates[(i / 2) % phaseCount];
+        simVars.altAboveGround = state->altAboveGround;
+        simVars.altAltitude = state->altAltitude;
+        simVars.vsiVerticalSpeed = state->verticalSpeed;
+        simVars.parkingBrakeOn = state->parkingBrakeOn;
+        simVars.pushbackState = state->pushbackState;
+        completedTakeOff = state->completedTakeOff;
+        sum += getCustomEvent(1 + i % 2);
+    }
+    benchSink = sum;
+}
+
+Benchmark benchmarks[] = {
+    { "diffWords", benchDiffKernel },
+    { "diffWordsScalar", benchDiffScalar },
+    { "snapshotFrame", benchSnapshot },
+    { "sendDelta v1 prep (4 panels)", benchDeltaV1 },
+    { "sendDelta v2 prep (4 panels)", benchDeltaV2 },
+    { "baseline sendDelta (4 panels)", benchDeltaBaseline },
+    { "sendFull prep (publish/take)", benchPublish },
+    { "updateA310FromJetbridge", benchA310Replies },
+    { "updateFbwFromJetbridge", benchFbwReplies },
+    { "baseline A310 strncmp/atof", benchA310Baseline },
+    { "baseline Fbw strncmp/atof", benchFbwBaseline },
+    { "atof (reply values)", benchAtof },
+    { "parseJetbridgeValue", benchParseValue },
+    { "writeJetbridgeVar format (x2)", benchWriteFormat },
+    { "writeJetbridgeVar send", benchWriteSend },
+    { "detectAircraft", benchDetectAircraft },
+    { "getCustomEvent", benchCustomEvent },
+    { NULL, NULL }
+};
+
+LONGLONG ticks()
+{
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    return count.QuadPart;
+}
+
+/// <summary>
+/// Keeps doubling the iterations until a run takes at least minMillis
+/// so quick functions aren't swamped by the timer.
+/// </summary>
+void runBenchmark(Benchmark* benchmark, double ticksPerNano)
+{
+    long iterations = 1;
+    double nanos = 0;
+
+    while (true) {
+        LONGLONG start = ticks();
+        benchmark->run(iterations);
+        nanos = (ticks() - start) / ticksPerNano;
+
+        if (nanos >= minMillis * 1000000.0 || iterations >= (1L << 30)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    printf("%-32s %12.1f ns %14.0f /sec %12ld\n", benchmark->name, nanos / iterations, iterations * 1e9 / nanos, iterations);
+}
+
+bool parseArgs(int argc, char* argv[], const char** recording)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--recording") == 0) {
+            *recording = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--change") == 0) {
+            changePercent = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0) {
+            filter = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--millis") == 0) {
+            minMillis = atoi(argv[i + 1]);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return argc % 2 == 1 && changePercent >= 0 && changePercent <= 100 && minMillis > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* recording = NULL;
+    if (!parseArgs(argc, argv, &recording)) {
+        printf("Usage: idl-microbench [--recording file] [--change percent] [--filter name] [--millis n]\n");
+        return 2;
+    }
+
+    if (!varLayoutInit()) {
+        return 2;
+    }
+
+    // The fake sim answers Jetbridge reads and swallows writes
+    HANDLE simEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    HANDLE hSimConnect = NULL;
+    if (SimConnect_Open(&hSimConnect, "Benchmark", NULL, 0, simEvent, 0) != 0) {
+        printf("Failed to open the fake sim\n");
+        return 2;
+    }
+    jetbridgeInit(hSimConnect);
+    activePanels = (1 << (LIGHTS_PANEL + 1)) - 1;
+
+    if (recording) {
+        if (!loadRecording(recording)) {
+            return 2;
+        }
+        printf("Inputs: %d frames and %d Jetbridge replies from %s\n", (int)benchFrames.size(), (int)(a310Replies.size() + fbwReplies.size()), recording);
+    }
+    else {
+        makeFrames();
+        printf("Inputs: %d synthetic frames with %d%% of vars changing\n", (int)benchFrames.size(), changePercent);
+    }
+
+    // Make up replies for whatever the recording doesn't have
+    if (a310Replies.empty()) {
+        makeReplies(hSimConnect, readA310Jetbridge, &a310Replies);
+    }
+    if (fbwReplies.empty()) {
+        makeReplies(hSimConnect, readFbwJetbridge, &fbwReplies);
+    }
+
+    for (std::vector<std::string>* replies : { &a310Replies, &fbwReplies }) {
+        for (const std::string& reply : *replies) {
+            replyValues.push_back(reply.substr(replyValuePos(reply)));
+        }
+    }
+    if (!checkParseValue()) {
+        return 1;
+    }
+    makeBaselineReplies(BaselineA310Vars, &a310BaselineReplies);
+    makeBaselineReplies(BaselineFbwVars, &fbwBaselineReplies);
+
+    printf("Jetbridge: %d A310 and %d Fbw replies, parseJetbridgeValue matches atof for all %d values\n", (int)a310Replies.size(), (int)fbwReplies.size(), (int)replyValues.size());
+    printf("Layout: %d vars, %d words, SimVars is %d bytes, diff kernel is %s\n\n", varCount, wordCount, (int)sizeof(SimVars), diffKernelName());
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    double ticksPerNano = freq.QuadPart / 1e9;
+
+    printf("%-32s %15s %19s %12s\n", "Benchmark", "Time/op", "Rate", "Iterations");
+    for (Benchmark* benchmark = benchmarks; benchmark->name; benchmark++) {
+        if (!filter || strstr(benchmark->name, filter)) {
+            runBenchmark(benchmark, ticksPerNano);
+        }
+    }
+
+    SimConnect_Close(hSimConnect);
+    CloseHandle(simEvent);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef _AIRCRAFT_H_
+#define _AIRCRAFT_H_
+
+#include "simvarDefs.h"
+#include "LVars-A310.h"
+#include "LVars-Fbw.h"
+
+// Works out which aircraft is loaded from its title and copies the vars
+// that some aircraft keep in lvars (read via Jetbridge) into the
+// standard SimVars the panels use.
+extern bool isA310;
+extern bool isFbw;
+extern bool isA320;
+extern bool isA380;
+extern bool is747;
+extern bool isK100;
+extern bool isPA28;
+extern bool isAirliner;
+extern bool isNewAircraft;
+
+extern LVars_A310 a310Vars;
+extern LVars_FBW fbwVars;
+
+void detectAircraft(const char* aircraft);
+void mapAircraftVars();
+
+#endif // _AIRCRAFT_H_
@@ -0,0 +1,12 @@
+#ifndef _DELTADECODER_H_
+#define _DELTADECODER_H_
+
+#include "simvarDefs.h"
+#include "varLayout.h"
+
+// Reference decoders for the deltas we send. Panels can use these as
+// they are (call varLayoutInit first) or as a guide for their own.
+bool applyDelta(const char* data, long dataSize, SimVars* vars);
+bool applyDeltaV2(const char* data, long dataSize, SimVars* vars, long* frameNo);
+
+#endif // _DELTADECODER_H_
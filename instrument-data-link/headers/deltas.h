@@ -0,0 +1,35 @@
+#ifndef _DELTAS_H_
+#define _DELTAS_H_
+
+#include <stdio.h>
+#include "simvarDefs.h"
+#include "sessions.h"
+#include "varLayout.h"
+
+// Every new SimConnect frame is diffed against the previous frame once and
+// the encoded delta is shared by all panels that have the same baseline.
+// Encoded deltas are cached for panels up to FrameHistory frames behind.
+// Which vars changed in each frame is kept for much longer (ChangeHistory
+// frames, over 30 secs at 30 fps) so a panel that polls slowly can still
+// be sent a merged delta rather than full data.
+const int FrameHistory = 16;
+const int ChangeHistory = 1024;
+const int MaxDeltaSize = 8192;
+
+// A v2 delta is only sent if it is smaller than full data
+const int MaxDeltaV2Size = sizeof(SimVars);
+
+struct Frame {
+    long frameNo;
+    SimVars vars;
+    unsigned long long* changed;    // Vars that changed since the previous frame (in the change history)
+};
+
+void deltasInit(SimVars* vars);
+void snapshotFrame(SimVars* vars);
+void snapshotDirtyFrame(SimVars* vars, const unsigned long long* dirty);
+Frame* latestFrame();
+const char* getDelta(long baseFrameNo, PANEL_TYPE panelType, long* deltaSize);
+const char* getDeltaV2(long baseFrameNo, PANEL_TYPE panelType, long* deltaSize);
+
+#endif // _DELTAS_H_
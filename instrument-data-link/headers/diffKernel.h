@@ -0,0 +1,30 @@
+#ifndef _DIFFKERNEL_H_
+#define _DIFFKERNEL_H_
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Compares two frames 8 bytes at a time and sets a bit in wordMask for
+// every word that differs. Uses AVX (4 doubles per compare) or SSE2
+// (2 doubles per compare) when the compiler targets them, otherwise
+// plain C++. Words are compared as doubles so the result matches !=.
+const int MaxWords = 512;
+const int WordMaskSize = MaxWords / 64;
+
+void diffWords(const double* oldWords, const double* newWords, int wordCount, unsigned long long* wordMask);
+void diffWordsScalar(const double* oldWords, const double* newWords, int wordCount, unsigned long long* wordMask);
+const char* diffKernelName();
+
+inline int lowestBit(unsigned long long bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+#endif // _DIFFKERNEL_H_
@@ -0,0 +1,32 @@
+#ifndef _DISPATCHLOOP_H_
+#define _DISPATCHLOOP_H_
+
+#include <windows.h>
+
+// The main loop sleeps until the message source signals its event and
+// then processes everything that is queued, rather than polling every
+// 10ms. The source is normally SimConnect but anything that can signal
+// an event and be drained (e.g. a fake sim) can drive the loop.
+const DWORD DispatchIdleMillis = 100;
+const DWORD DispatchRetryMillis = 2000;
+
+struct MessageSource {
+    const char* name;
+    bool (*connect)(HANDLE event);  // Returns true if connected. Event must be signalled when there are messages.
+    int (*dispatch)();              // Process all queued messages. Returns number processed or -1 if disconnected.
+    void (*disconnected)();
+    HANDLE wakeEvent;               // Optional. Call wakeup when signalled, even if not connected.
+    void (*wakeup)();
+};
+
+struct DispatchStats {
+    long wakeups;       // Woken by the event
+    long timeouts;      // Woken by the idle timeout
+    long messages;
+};
+
+extern DispatchStats dispatchStats;
+
+void dispatchLoop(MessageSource* source, bool* quit);
+
+#endif // _DISPATCHLOOP_H_
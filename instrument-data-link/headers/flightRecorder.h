@@ -0,0 +1,54 @@
+#ifndef _FLIGHTRECORDER_H_
+#define _FLIGHTRECORDER_H_
+
+#include <windows.h>
+#include "SimConnect.h"
+
+// Records the var data SimConnect sends (including Jetbridge replies)
+// so a real flight can be replayed later without the sim, e.g. to test
+// or benchmark changes against the same data every time.
+//
+// Each message is stored with the time it arrived. A message that is
+// the same size as the last one for its request only stores the 4 byte
+// words that have changed, which is most of them. A recording can only
+// be replayed with the same SimVarDefs it was made with.
+const char RecordingMagic[8] = "IDLREC1";
+const int MaxRecordSize = 16384;
+const int MaxRecordStreams = 8;
+
+struct RecordingHeader {
+    char magic[8];
+    DWORD layoutHash;       // Changes if SimVarDefs changes
+    DWORD simVarsSize;
+};
+
+enum RECORD_KIND {
+    RECORD_MESSAGE,         // The whole message
+    RECORD_CHANGES          // Stream, word mask and the words that changed
+};
+
+struct RecordHeader {
+    DWORD millis;           // Since the recording started
+    DWORD kind;
+    DWORD size;             // Bytes that follow
+};
+
+struct ReplayStats {
+    long messages;
+    long changes;           // Messages that were stored as changes
+    ULONGLONG startMillis;
+    ULONGLONG recordedMillis;
+};
+
+extern ReplayStats replayStats;
+
+bool recorderOpen(const char* filename);
+void recordMessage(SIMCONNECT_RECV* pData);
+void recorderClose();
+
+bool replayOpen(const char* filename, double speed, HANDLE event);
+bool replayRewind();
+int replayDispatch(DispatchProc dispatchProc);
+void replayClose();
+
+#endif // _FLIGHTRECORDER_H_
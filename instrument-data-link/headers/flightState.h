@@ -0,0 +1,27 @@
+#ifndef _FLIGHTSTATE_H_
+#define _FLIGHTSTATE_H_
+
+#include "simvarDefs.h"
+
+// Keeps track of how far through the flight we are (boarding, pushback,
+// takeoff, landing etc.) so the event buttons can trigger the right
+// cabin announcement.
+enum FLIGHT_PHASE {
+    GROUND,
+    TAKEOFF,
+    CLIMB,
+    CRUISE,
+    DESCENT,
+    APPROACH,
+    GO_AROUND
+};
+
+extern bool initiatedPushback;
+extern bool completedTakeOff;
+extern bool hasFlown;
+extern int onStandState;
+
+void updateFlightState();
+EVENT_ID getCustomEvent(int eventNum);
+
+#endif // _FLIGHTSTATE_H_
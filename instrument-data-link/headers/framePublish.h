@@ -0,0 +1,24 @@
+#ifndef _FRAMEPUBLISH_H_
+#define _FRAMEPUBLISH_H_
+
+#include <atomic>
+#include <windows.h>
+#include "simvarDefs.h"
+#include "varLayout.h"
+
+// The SimConnect thread builds each frame in simVars and then publishes
+// a copy of it. The server thread takes the latest published copy. There
+// are three copies so neither thread ever waits for the other and the
+// server never sees a half written frame.
+struct PublishedFrame {
+    long simFrame;
+    LONGLONG publishedTime;     // See stageTiming.h
+    SimVars vars;
+};
+
+void publishInit(SimVars* vars);
+void publishFrame(SimVars* vars, const unsigned long long* dirty);
+bool isFrameWaiting();
+PublishedFrame* takeFrame(unsigned long long* dirty);
+
+#endif // _FRAMEPUBLISH_H_
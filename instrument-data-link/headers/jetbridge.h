@@ -16,19 +16,33 @@
 
 #ifdef jetbridgeFallback
 
-#include "..\jetbridge\Client.h"
+#include "../jetbridge/Client.h"
 
 const char DRONE_CAMERA_FOV[] = "A:DRONE CAMERA FOV, percent";
 
+// Several writes can be combined into one RPN program so they go in as
+// few packets as possible. Start with an empty program, add the writes
+// and then send it.
+struct RpnProgram {
+    char rpnCode[jetbridge::kPacketDataSize];
+    int codeLen;
+};
+
 void jetbridgeInit(HANDLE hSimConnect);
 
 void readJetbridgeVar(const char* var);
 void writeJetbridgeVar(const char* var, double val = 0);
 void writeJetbridgeVar(EVENT_ID eventId, double val);
 void writeJetbridgeHvar(const char* var);
+void writeJetbridgeVar(RpnProgram* program, const char* var, double val);
+void writeJetbridgeVar(RpnProgram* program, EVENT_ID eventId, double val);
+void sendJetbridgeProgram(RpnProgram* program);
 
+bool jetbridgeReply(const jetbridge::Packet* packet);
+jetbridge::ClientStats jetbridgeStats();
 void updateA310FromJetbridge(const char* data);
 void updateFbwFromJetbridge(const char* data);
+double parseJetbridgeValue(const char* str);
 
 bool jetbridgeA310ButtonPress(int eventId, double value);
 bool jetbridgeFbwButtonPress(int eventId, double value);
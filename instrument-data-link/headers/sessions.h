@@ -0,0 +1,48 @@
+#ifndef _SESSIONS_H_
+#define _SESSIONS_H_
+
+#include <windows.h>
+#include <stdio.h>
+#include <atomic>
+#include "simvarDefs.h"
+
+// Every panel that polls us gets its own session (keyed by address and
+// port) so several panels of the same type can be connected at once and
+// each one receives correct deltas against its own baseline.
+const int MaxSessions = 16;
+
+// A panel that hasn't polled for this long is treated as disconnected
+// and will be sent full data again if it comes back.
+const ULONGLONG SessionTimeoutMillis = 2000;
+
+enum PANEL_TYPE {
+    INSTRUMENT_PANEL,
+    AUTOPILOT_PANEL,
+    RADIO_PANEL,
+    LIGHTS_PANEL
+};
+
+struct Session {
+    bool inUse;
+    bool connected;
+    sockaddr_in addr;
+    PANEL_TYPE panelType;
+    ULONGLONG lastRequest;
+    long frameNo;       // Last frame sent to this panel (its delta baseline)
+    bool deltaV2;       // Panel wants v2 (bitmap) deltas
+    bool subscribed;
+    ULONGLONG pushIntervalMillis;
+    ULONGLONG lastPush;
+};
+
+extern Session sessions[MaxSessions];
+extern std::atomic<int> activePanels;   // Bit set for each PANEL_TYPE that has a session
+
+void sessionsInit();
+Session* findSession(sockaddr_in* addr, PANEL_TYPE panelType);
+void subscribe(Session* session, double maxPerSecond);
+int expireSessions();
+const char* panelName(PANEL_TYPE panelType);
+long panelDataSize(PANEL_TYPE panelType);
+
+#endif // _SESSIONS_H_
@@ -397,6 +397,24 @@ struct WriteEvent {
     const char* name;
 };
 
+// How often SimConnect sends a var. Vars are read every frame unless
+// they are listed in VarRates.
+enum VAR_RATE {
+    RATE_FRAME,
+    RATE_SECOND,
+    RATE_CHANGED
+};
+
+struct VarRate {
+    const char* name;
+    VAR_RATE rate;
+};
+
+struct VarDeadband {
+    const char* name;
+    double deadband;    // In the units given in SimVarDefs
+};
+
 struct WriteData {
     EVENT_ID eventId;
     double value;
@@ -408,6 +426,22 @@ struct PosData {
     double heading;
 };
 
+// Panels that poll set wantFullData to REQUEST_DELTA or REQUEST_FULL.
+// A panel can instead subscribe (writeData.value = max updates per second,
+// 0 = every frame) and the server will push a delta to it whenever there
+// is a new SimConnect frame. Subscribed panels must resend the subscribe
+// request at least once a second to keep their session alive.
+enum REQUEST_MODE {
+    REQUEST_DELTA,
+    REQUEST_FULL,
+    REQUEST_SUBSCRIBE,
+    REQUEST_UNSUBSCRIBE
+};
+
+// Add DeltaFormatV2 to wantFullData to be sent v2 deltas instead.
+const int RequestModeMask = 0xff;
+const int DeltaFormatV2 = 0x100;
+
 struct Request {
     int requestedSize;
     int wantFullData;
@@ -424,4 +458,17 @@ struct DeltaString {
     char data[32];
 };
 
+// A v2 delta is this header followed by a bitmap with one bit for each
+// var the panel requested (in SimVarDefs order, lowest bit first), then
+// the new value of each changed var packed with no padding. Doubles are
+// 8 bytes and strings are a length byte followed by the characters.
+// As with v1 a panel receives full data instead if the delta wouldn't
+// be any smaller.
+struct DeltaHeaderV2 {
+    int frameNo;
+    unsigned char version;      // Always 2
+    unsigned char connected;
+    unsigned short varCount;    // Number of bits in the bitmap
+};
+
 #endif // _SIMVARDEFS_H_
@@ -0,0 +1,31 @@
+#ifndef _STAGETIMING_H_
+#define _STAGETIMING_H_
+
+#include <windows.h>
+
+// Records how long each stage between the sim and the panels takes so
+// it is easy to see where the latency is. Each stage must only ever be
+// recorded by one thread.
+enum STAGE {
+    STAGE_WRITES,       // Sending queued panel writes to the sim
+    STAGE_TIMERS,       // Jetbridge reads and other timers
+    STAGE_DISPATCH,     // Processing SimConnect messages
+    STAGE_HANDOFF,      // Frame published until the server takes it
+    STAGE_SEND,         // Diffing the frame and pushing it to panels
+    STAGE_COUNT
+};
+
+struct StageTiming {
+    long count;
+    double totalMicros;
+    double maxMicros;
+};
+
+extern StageTiming stageTimings[STAGE_COUNT];
+
+void stageTimingInit();
+LONGLONG stageStart();
+void stageDone(STAGE stage, LONGLONG start);
+void showStageTimings();
+
+#endif // _STAGETIMING_H_
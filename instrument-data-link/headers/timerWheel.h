@@ -0,0 +1,28 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+// Runs callbacks at a future time without anyone having to sleep, e.g.
+// releasing a vJoy button 60ms after it was pressed. Timers are kept in
+// a wheel of slots (one slot per 10ms) so scheduling and running them
+// doesn't depend on how many are waiting. The current time is always
+// passed in so the wheel can be driven by a fake clock.
+//
+// Only the thread that owns SimConnect (the dispatch loop) should use it.
+const int TimerSlots = 64;
+const int TimerSlotMillis = 10;
+const int MaxTimers = 64;
+
+typedef void (*TimerCallback)(int arg);
+
+// Called at the end of every runTimers. Returns true if it wants
+// calling again on the next tick.
+typedef bool (*TimerTickCallback)(unsigned long long now);
+
+void timerWheelInit(unsigned long long now);
+bool scheduleTimer(unsigned long long now, unsigned long delayMillis, TimerCallback callback, int arg);
+int runTimers(unsigned long long now);
+unsigned long nextTimerMillis(unsigned long long now);
+unsigned long long timerNow();
+void setTimerTickCallback(TimerTickCallback callback);
+
+#endif // _TIMERWHEEL_H_
@@ -0,0 +1,41 @@
+#ifndef _VARLAYOUT_H_
+#define _VARLAYOUT_H_
+
+#include <stdio.h>
+#include "simvarDefs.h"
+#include "diffKernel.h"
+
+// SimVarDefs is compiled into this table once at startup so nothing
+// on the hot path has to parse the unit strings again.
+const int MaxVars = 256;
+const int VarMaskSize = MaxVars / 64;
+
+enum VAR_KIND {
+    VAR_JETBRIDGE,
+    VAR_DOUBLE,
+    VAR_STRING32,
+    VAR_INTERNAL
+};
+
+struct VarLayout {
+    const char* name;
+    const char* units;
+    short offset;               // Byte offset into SimVars
+    short size;
+    VAR_KIND kind;
+    unsigned char panelMask;    // Bit set for each PANEL_TYPE that needs this var
+    double deadband;            // Ignore changes smaller than this (0 = send any change)
+    VAR_RATE rate;              // How often SimConnect sends it
+    bool mapped;                // Overwritten by aircraft specific vars
+};
+
+extern VarLayout varLayout[MaxVars];
+extern int varCount;
+extern int wordCount;
+extern short wordVar[MaxWords]; // Var that each 8 byte word of SimVars belongs to (-1 = connected)
+extern short deadbandVars[MaxVars];
+extern int deadbandCount;
+
+bool varLayoutInit();
+
+#endif // _VARLAYOUT_H_
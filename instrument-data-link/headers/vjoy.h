@@ -10,7 +10,9 @@
 //    http://vjoystick.sourceforge.net/site/index.php/download-a-install/download
 //
 // Comment the following line out if you don't want to use vJoy.
+#ifdef _WIN32
 #define vJoyFallback
+#endif
 
 #ifdef vJoyFallback
 
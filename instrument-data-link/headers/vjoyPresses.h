@@ -0,0 +1,23 @@
+#ifndef _VJOYPRESSES_H_
+#define _VJOYPRESSES_H_
+
+#include "simvarDefs.h"
+
+// Turns vJoy button events into timed press/release cycles using the
+// timer wheel. Every press is a separate cycle so the game sees each
+// one, even if the same button is pressed again before it has been
+// released. The vJoy driver is behind a function pointer so this can
+// be driven by a fake clock and a fake backend.
+//
+// Only the thread that owns SimConnect (the dispatch loop) should use it.
+const int VJoyPressMillis = 60;     // How long a button is held down for
+const int VJoyGapMillis = 60;       // How long it is up between presses
+const int VJoyButtonCount = VJOY_BUTTONS_END - VJOY_BUTTONS + 1;
+
+typedef void (*VJoySetButton)(int button, bool down);
+
+void vJoyPressesInit(VJoySetButton setButton);
+void queueVJoyPress(int button, unsigned long long now);
+int pendingVJoyPresses(int button);
+
+#endif // _VJOYPRESSES_H_
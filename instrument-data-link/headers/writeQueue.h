@@ -0,0 +1,37 @@
+#ifndef _WRITEQUEUE_H_
+#define _WRITEQUEUE_H_
+
+#include <windows.h>
+#include <atomic>
+#include "simvarDefs.h"
+
+// Writes from panels are queued by the server thread and carried out by
+// the thread that owns the SimConnect handle. This means SimConnect (and
+// vJoy) are only used from one thread and the server never has to wait
+// for them. Any number of threads can queue writes but only one thread
+// can take them.
+const int WriteQueueSize = 256;     // Must be a power of 2
+
+struct WriteCommand {
+    WriteData writeData;
+    sockaddr_in addr;       // Panel that sent the write
+    LONGLONG queuedTime;    // Performance counter when queued
+};
+
+struct WriteQueueStats {
+    std::atomic<long> queued;
+    std::atomic<long> dropped;  // Queue was full
+    long done;
+    double totalMicros;         // Time from queued to transmitted
+    double maxMicros;
+};
+
+extern WriteQueueStats writeQueueStats;
+
+void writeQueueInit();
+HANDLE writeQueueEvent();
+bool queueWrite(WriteData* writeData, sockaddr_in* addr);
+bool takeWrite(WriteCommand* command);
+void writeDone(WriteCommand* command);
+
+#endif // _WRITEQUEUE_H_
@@ -3,7 +3,11 @@
 
 jetbridge::Client::Client(void* simconnect) {
   this->simconnect = simconnect;
-  srand(time(0));
+
+  // There is no sim to talk to when replaying a recording
+  if (simconnect == nullptr) {
+    return;
+  }
 
   SimConnect_AddToClientDataDefinition(simconnect, kPacketDefinition, 0, sizeof(Packet));
   SimConnect_MapClientDataNameToID(simconnect, kPublicDownlinkChannel, kPublicDownlinkArea);
@@ -15,9 +19,116 @@ jetbridge::Client::Client(void* simconnect) {
 }
 
 void jetbridge::Client::request(const char data[]) {
-  // Prepare the outgoing packet
-  Packet* packet = new Packet(data);
+  // Prepare the outgoing packet. SimConnect copies it before returning
+  // so it can live on the stack, which keeps this safe to call from the
+  // polling and SimConnect threads at the same time.
+  Packet packet(++nextId, data);
+  if (simconnect == nullptr) {
+    return;
+  }
+
+  // The module still replies so remember not to expect it
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    wantsReply[(unsigned int)packet.id % kIdHistory] = false;
+  }
 
   // Transmit the request packet
-  SimConnect_SetClientData(simconnect, kPublicUplinkArea, kPacketDefinition, 0, 0, sizeof(Packet), packet);
+  SimConnect_SetClientData(simconnect, kPublicUplinkArea, kPacketDefinition, 0, 0, sizeof(Packet), &packet);
+}
+
+bool jetbridge::Client::request(const char data[], ReplyHandler handler, void* context) {
+  Packet packet(++nextId, data);
+  if (simconnect == nullptr) {
+    return false;
+  }
+
+  // Refuse new requests rather than let them pile up if replies stop arriving
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    if (pendingCount == kMaxPendingRequests) {
+      stats.refused++;
+      return false;
+    }
+
+    PendingRequest* entry = &pending[pendingCount];
+    pendingCount++;
+    wantsReply[(unsigned int)packet.id % kIdHistory] = true;
+    entry->id = packet.id;
+    entry->sentMillis = GetTickCount64();
+    entry->handler = handler;
+    entry->context = context;
+  }
+
+  SimConnect_SetClientData(simconnect, kPublicUplinkArea, kPacketDefinition, 0, 0, sizeof(Packet), &packet);
+  return true;
+}
+
+bool jetbridge::Client::handleReply(const Packet* packet) {
+  PendingRequest entry;
+
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    int i = 0;
+    while (i < pendingCount && pending[i].id != packet->id) {
+      i++;
+    }
+
+    if (i == pendingCount) {
+      if (wantsReply[(unsigned int)packet->id % kIdHistory]) {
+        stats.unmatched++;
+      } else {
+        stats.unwanted++;
+      }
+      return false;
+    }
+
+    entry = pending[i];
+    pendingCount--;
+    pending[i] = pending[pendingCount];
+
+    double roundTrip = (double)(GetTickCount64() - entry.sentMillis);
+    stats.replies++;
+    stats.totalRoundTripMillis += roundTrip;
+    if (roundTrip > stats.maxRoundTripMillis) {
+      stats.maxRoundTripMillis = roundTrip;
+    }
+  }
+
+  // Call the handler outside the lock so it can make new requests
+  entry.handler(entry.context, packet->data);
+  return true;
+}
+
+void jetbridge::Client::expireRequests() {
+  PendingRequest expired[kMaxPendingRequests];
+  int expiredCount = 0;
+  ULONGLONG now = GetTickCount64();
+
+  {
+    std::lock_guard<std::mutex> lock(pendingLock);
+    int i = 0;
+    while (i < pendingCount) {
+      if (now - pending[i].sentMillis < kRequestTimeoutMillis) {
+        i++;
+        continue;
+      }
+
+      expired[expiredCount] = pending[i];
+      expiredCount++;
+      pendingCount--;
+      pending[i] = pending[pendingCount];
+    }
+    stats.timeouts += expiredCount;
+  }
+
+  for (int i = 0; i < expiredCount; i++) {
+    expired[i].handler(expired[i].context, nullptr);
+  }
+}
+
+jetbridge::ClientStats jetbridge::Client::getStats() {
+  std::lock_guard<std::mutex> lock(pendingLock);
+  stats.outstanding = pendingCount;
+  return stats;
 }
@@ -1,21 +1,62 @@
 #pragma once
 
-#include <Windows.h>
+#include <windows.h>
 
+#include <atomic>
 #include <future>
 #include <map>
+#include <mutex>
 
 #include "Protocol.h"
 
 namespace jetbridge {
 
+// Called with the reply data, or with nullptr if the request timed out.
+typedef void (*ReplyHandler)(void* context, const char data[]);
+
+static const int kMaxPendingRequests = 64;
+static const ULONGLONG kRequestTimeoutMillis = 1000;
+
+// How many recent ids we remember whether a reply was wanted for
+static const int kIdHistory = 1024;
+
+struct PendingRequest {
+  int id;
+  ULONGLONG sentMillis;
+  ReplyHandler handler;
+  void* context;
+};
+
+struct ClientStats {
+  int outstanding;
+  long replies;
+  long timeouts;
+  long refused;
+  long unmatched;   // Replies that came too late (after a timeout)
+  long unwanted;    // Replies to requests that didn't ask for one
+  double totalRoundTripMillis;
+  double maxRoundTripMillis;
+};
+
 class Client {
  private:
   void* simconnect = 0;
+  std::atomic<int> nextId{0};
+
+  // Requests that asked for a reply and haven't had one yet
+  std::mutex pendingLock;
+  PendingRequest pending[kMaxPendingRequests];
+  int pendingCount = 0;
+  bool wantsReply[kIdHistory] = {};
+  ClientStats stats = {};
 
  public:
   Client(void* simconnect);
   void request(const char data[]);
+  bool request(const char data[], ReplyHandler handler, void* context);
+  bool handleReply(const Packet* packet);
+  void expireRequests();
+  ClientStats getStats();
 };
 
 }  // namespace jetbridge
@@ -4,9 +4,9 @@
 #include <cstring>
 #include <ctime>
 
-jetbridge::Packet::Packet(const char data[]) {
-	this->id = rand();
+jetbridge::Packet::Packet(int id, const char data[]) {
+  this->id = id;
 
-  // Copy the passed data to the packet data
-  std::memcpy(this->data, data, sizeof(this->data));
+  // Copy the passed data to the packet data (always leave it terminated)
+  std::strncpy(this->data, data, sizeof(this->data) - 1);
 }
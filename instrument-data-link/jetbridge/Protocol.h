@@ -10,7 +10,7 @@ class Packet {
  public:
   int id;
   char data[kPacketDataSize] = {};
-  Packet(const char data[]);
+  Packet(int id, const char data[]);
 };
 
 enum ClientDataDefinitions {
@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "SimConnect.h"
+
+// A made up sim for running the data link without FS2020. Each frame a
+// share of the numeric vars drift a little so panels get a realistic
+// mix of changed and unchanged vars. Jetbridge packets are answered
+// with a value of 0. Settings are read from the environment:
+//
+//    FAKESIM_AIRCRAFT   Aircraft title (default "Fake Sim Aircraft")
+//    FAKESIM_FPS        Frames per second (default 30)
+//    FAKESIM_CHANGE     Percentage of vars that change each frame (default 10)
+//    FAKESIM_SEED       Makes the same values each run (default 1)
+const int MaxFakeDefs = 4;
+const int MaxFakeDatums = 256;
+const int MaxFakeRequests = 8;
+const int MaxFakeAreas = 4;
+const int MaxFakeReplies = 64;
+const int MaxClientDataSize = 256;
+const int MaxFakeMessage = 65536;
+
+struct FakeDatum {
+    char name[64];
+    SIMCONNECT_DATATYPE type;
+    DWORD datumId;
+    double value;
+    bool changed;
+};
+
+struct FakeDef {
+    DWORD defineId;
+    int count;
+    FakeDatum datums[MaxFakeDatums];
+};
+
+struct FakeRequest {
+    DWORD requestId;
+    FakeDef* def;
+    SIMCONNECT_PERIOD period;
+    DWORD flags;
+    bool sent;
+    ULONGLONG lastSent;
+};
+
+struct FakeArea {
+    DWORD areaId;
+    bool isUplink;
+};
+
+struct FakeReply {
+    int size;
+    char data[MaxClientDataSize];
+};
+
+struct FakeSim {
+    HANDLE event;
+    std::atomic<bool> running;
+    std::thread ticker;
+    char aircraft[32];
+    int frameMillis;
+    unsigned int changeThreshold;
+    unsigned int seed;
+    ULONGLONG nextFrame;
+    bool firstFrame;
+
+    int defCount;
+    FakeDef defs[MaxFakeDefs];
+    int requestCount;
+    FakeRequest requests[MaxFakeRequests];
+
+    int areaCount;
+    FakeArea areas[MaxFakeAreas];
+    DWORD clientDefSize;
+    DWORD downlinkRequestId;
+    DWORD downlinkDefineId;
+    bool hasDownlink;
+
+    std::mutex replyLock;
+    int replyCount;
+    FakeReply replies[MaxFakeReplies];
+};
+
+FakeSim fakeSim;
+char fakeMessage[MaxFakeMessage];
+
+static int envInt(const char* name, int defaultValue)
+{
+    const char* value = getenv(name);
+    return value ? atoi(value) : defaultValue;
+}
+
+static unsigned int nextRandom()
+{
+    fakeSim.seed = fakeSim.seed * 1664525 + 1013904223;
+    return fakeSim.seed;
+}
+
+static int datumSize(SIMCONNECT_DATATYPE type)
+{
+    switch (type) {
+    case SIMCONNECT_DATATYPE_INT32:
+    case SIMCONNECT_DATATYPE_FLOAT32:
+        return 4;
+    case SIMCONNECT_DATATYPE_STRING32:
+        return 32;
+    default:
+        return 8;
+    }
+}
+
+static void tick()
+{
+    while (fakeSim.running) {
+        Sleep(fakeSim.frameMillis);
+        SetEvent(fakeSim.event);
+    }
+}
+
+/// <summary>
+/// Drift some of the numeric vars. Strings only change on the
+/// first frame.
+/// </summary>
+static void makeFrame()
+{
+    for (int i = 0; i < fakeSim.defCount; i++) {
+        FakeDef* def = &fakeSim.defs[i];
+        for (int j = 0; j < def->count; j++) {
+            FakeDatum* datum = &def->datums[j];
+            if (datum->type == SIMCONNECT_DATATYPE_STRING32 || datum->type == SIMCONNECT_DATATYPE_STRING8) {
+                datum->changed = fakeSim.firstFrame;
+            }
+            else {
+                datum->changed = fakeSim.firstFrame || (nextRandom() >> 8) % 10000 < fakeSim.changeThreshold;
+                if (datum->changed) {
+                    datum->value += ((int)(nextRandom() >> 16 & 0xff) - 128) / 64.0;
+                }
+            }
+        }
+    }
+
+    fakeSim.firstFrame = false;
+}
+
+static char* writeDatum(char* data, FakeDatum* datum)
+{
+    switch (datum->type) {
+    case SIMCONNECT_DATATYPE_INT32:
+    {
+        int value = (int)datum->value;
+        memcpy(data, &value, 4);
+        return data + 4;
+    }
+    case SIMCONNECT_DATATYPE_INT64:
+    {
+        long long value = (long long)datum->value;
+        memcpy(data, &value, 8);
+        return data + 8;
+    }
+    case SIMCONNECT_DATATYPE_FLOAT32:
+    {
+        float value = (float)datum->value;
+        memcpy(data, &value, 4);
+        return data + 4;
+    }
+    case SIMCONNECT_DATATYPE_STRING8:
+    case SIMCONNECT_DATATYPE_STRING32:
+    {
+        int size = datumSize(datum->type);
+        memset(data, 0, size);
+        if (_stricmp(datum->name, "Title") == 0) {
+            strncpy(data, fakeSim.aircraft, size - 1);
+        }
+        else {
+            strncpy(data, "Fake", size - 1);
+        }
+        return data + size;
+    }
+    default:
+        memcpy(data, &datum->value, 8);
+        return data + 8;
+    }
+}
+
+static void sendRequest(FakeRequest* request, ULONGLONG now, DispatchProc dispatchProc, void* context)
+{
+    switch (request->period) {
+    case SIMCONNECT_PERIOD_NEVER:
+        return;
+    case SIMCONNECT_PERIOD_ONCE:
+        if (request->sent) {
+            return;
+        }
+        break;
+    case SIMCONNECT_PERIOD_SECOND:
+        if (request->sent && now - request->lastSent < 1000) {
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    FakeDef* def = request->def;
+    bool tagged = (request->flags & SIMCONNECT_DATA_REQUEST_FLAG_TAGGED) != 0;
+    bool changedOnly = (request->flags & SIMCONNECT_DATA_REQUEST_FLAG_CHANGED) != 0;
+
+    // Make sure the message isn't bigger than the buffer
+    if (def->count * (32 + sizeof(DWORD)) + sizeof(SIMCONNECT_RECV_SIMOBJECT_DATA) > MaxFakeMessage) {
+        return;
+    }
+
+    SIMCONNECT_RECV_SIMOBJECT_DATA* msg = (SIMCONNECT_RECV_SIMOBJECT_DATA*)fakeMessage;
+    char* data = (char*)&msg->dwData;
+    int changedCount = 0;
+    int sentCount = 0;
+
+    for (int i = 0; i < def->count; i++) {
+        FakeDatum* datum = &def->datums[i];
+        bool changed = datum->changed || !request->sent;
+        if (changed) {
+            changedCount++;
+        }
+
+        if (tagged) {
+            if (!changed) {
+                continue;
+            }
+            memcpy(data, &datum->datumId, sizeof(DWORD));
+            data += sizeof(DWORD);
+        }
+        data = writeDatum(data, datum);
+        sentCount++;
+    }
+
+    if (changedOnly && changedCount == 0) {
+        return;
+    }
+
+    msg->dwSize = (DWORD)(data - fakeMessage);
+    msg->dwVersion = 0;
+    msg->dwID = SIMCONNECT_RECV_ID_SIMOBJECT_DATA;
+    msg->dwRequestID = request->requestId;
+    msg->dwObjectID = SIMCONNECT_OBJECT_ID_USER;
+    msg->dwDefineID = def->defineId;
+    msg->dwFlags = request->flags;
+    msg->dwentrynumber = 1;
+    msg->dwoutof = 1;
+    msg->dwDefineCount = sentCount;
+
+    request->sent = true;
+    request->lastSent = now;
+    dispatchProc(msg, msg->dwSize, context);
+}
+
+HRESULT SimConnect_Open(HANDLE* phSimConnect, const char* szName, HWND hWnd, DWORD UserEventWin32, HANDLE hEventHandle, DWORD ConfigIndex)
+{
+    if (fakeSim.running) {
+        return -1;
+    }
+
+    const char* aircraft = getenv("FAKESIM_AIRCRAFT");
+    strncpy(fakeSim.aircraft, aircraft ? aircraft : "Fake Sim Aircraft", sizeof(fakeSim.aircraft) - 1);
+    fakeSim.aircraft[sizeof(fakeSim.aircraft) - 1] = '\0';
+
+    int fps = envInt("FAKESIM_FPS", 30);
+    fakeSim.frameMillis = fps > 0 && fps <= 1000 ? 1000 / fps : 33;
+    fakeSim.changeThreshold = envInt("FAKESIM_CHANGE", 10) * 100;
+    fakeSim.seed = envInt("FAKESIM_SEED", 1);
+    fakeSim.nextFrame = GetTickCount64();
+    fakeSim.firstFrame = true;
+
+    fakeSim.defCount = 0;
+    fakeSim.requestCount = 0;
+    fakeSim.areaCount = 0;
+    fakeSim.clientDefSize = 0;
+    fakeSim.hasDownlink = false;
+    fakeSim.replyCount = 0;
+
+    printf("Fake sim: %s at %d fps\n", fakeSim.aircraft, 1000 / fakeSim.frameMillis);
+
+    fakeSim.event = hEventHandle;
+    fakeSim.running = true;
+    fakeSim.ticker = std::thread(tick);
+    *phSimConnect = &fakeSim;
+    return S_OK;
+}
+
+HRESULT SimConnect_Close(HANDLE hSimConnect)
+{
+    if (fakeSim.running) {
+        fakeSim.running = false;
+        fakeSim.ticker.join();
+    }
+    return S_OK;
+}
+
+/// <summary>
+/// Sends any Jetbridge replies and then a frame if one is due.
+/// </summary>
+HRESULT SimConnect_CallDispatch(HANDLE hSimConnect, DispatchProc pfcnDispatch, void* pContext)
+{
+    FakeReply replies[MaxFakeReplies];
+    int replyCount;
+    {
+        std::lock_guard<std::mutex> lock(fakeSim.replyLock);
+        replyCount = fakeSim.replyCount;
+        memcpy(replies, fakeSim.replies, replyCount * sizeof(FakeReply));
+        fakeSim.replyCount = 0;
+    }
+
+    for (int i = 0; i < replyCount; i++) {
+        SIMCONNECT_RECV_CLIENT_DATA* msg = (SIMCONNECT_RECV_CLIENT_DATA*)fakeMessage;
+        memcpy(&msg->dwData, replies[i].data, replies[i].size);
+        msg->dwSize = (DWORD)((char*)&msg->dwData - fakeMessage) + replies[i].size;
+        msg->dwVersion = 0;
+        msg->dwID = SIMCONNECT_RECV_ID_CLIENT_DATA;
+        msg->dwRequestID = fakeSim.downlinkRequestId;
+        msg->dwObjectID = SIMCONNECT_OBJECT_ID_USER;
+        msg->dwDefineID = fakeSim.downlinkDefineId;
+        msg->dwFlags = 0;
+        msg->dwentrynumber = 1;
+        msg->dwoutof = 1;
+        msg->dwDefineCount = 1;
+        pfcnDispatch(msg, msg->dwSize, pContext);
+    }
+
+    ULONGLONG now = GetTickCount64();
+    if (now < fakeSim.nextFrame) {
+        return S_OK;
+    }
+
+    fakeSim.nextFrame += fakeSim.frameMillis;
+    if (fakeSim.nextFrame <= now) {
+        fakeSim.nextFrame = now + fakeSim.frameMillis;
+    }
+
+    makeFrame();
+
+    // Slower vars first so they go out with the frame
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < fakeSim.requestCount; i++) {
+            FakeRequest* request = &fakeSim.requests[i];
+            bool isFrame = request->period == SIMCONNECT_PERIOD_VISUAL_FRAME && !(request->flags & SIMCONNECT_DATA_REQUEST_FLAG_CHANGED);
+            if (isFrame == (pass == 1)) {
+                sendRequest(request, now, pfcnDispatch, pContext);
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT SimConnect_AddToDataDefinition(HANDLE hSimConnect, SIMCONNECT_DATA_DEFINITION_ID DefineID, const char* DatumName, const char* UnitsName,
+    SIMCONNECT_DATATYPE DatumType, float fEpsilon, DWORD DatumID)
+{
+    FakeDef* def = NULL;
+    for (int i = 0; i < fakeSim.defCount; i++) {
+        if (fakeSim.defs[i].defineId == DefineID) {
+            def = &fakeSim.defs[i];
+        }
+    }
+
+    if (!def) {
+        if (fakeSim.defCount == MaxFakeDefs) {
+            return -1;
+        }
+        def = &fakeSim.defs[fakeSim.defCount];
+        fakeSim.defCount++;
+        def->defineId = DefineID;
+        def->count = 0;
+    }
+
+    if (def->count == MaxFakeDatums) {
+        return -1;
+    }
+
+    FakeDatum* datum = &def->datums[def->count];
+    def->count++;
+    strncpy(datum->name, DatumName, sizeof(datum->name) - 1);
+    datum->name[sizeof(datum->name) - 1] = '\0';
+    datum->type = DatumType;
+    datum->datumId = DatumID;
+    datum->value = 0;
+    datum->changed = false;
+    return S_OK;
+}
+
+HRESULT SimConnect_RequestDataOnSimObject(HANDLE hSimConnect, SIMCONNECT_DATA_REQUEST_ID RequestID, SIMCONNECT_DATA_DEFINITION_ID DefineID,
+    SIMCONNECT_OBJECT_ID ObjectID, SIMCONNECT_PERIOD Period, SIMCONNECT_DATA_REQUEST_FLAG Flags, DWORD origin, DWORD interval, DWORD limit)
+{
+    FakeDef* def = NULL;
+    for (int i = 0; i < fakeSim.defCount; i++) {
+        if (fakeSim.defs[i].defineId == DefineID) {
+            def = &fakeSim.defs[i];
+        }
+    }
+
+    if (!def) {
+        return -1;
+    }
+
+    FakeRequest* request = NULL;
+    for (int i = 0; i < fakeSim.requestCount; i++) {
+        if (fakeSim.requests[i].requestId == RequestID) {
+            request = &fakeSim.requests[i];
+        }
+    }
+
+    if (!request) {
+        if (fakeSim.requestCount == MaxFakeRequests) {
+            return -1;
+        }
+        request = &fakeSim.requests[fakeSim.requestCount];
+        fakeSim.requestCount++;
+    }
+
+    request->requestId = RequestID;
+    request->def = def;
+    request->period = Period;
+    request->flags = Flags;
+    request->sent = false;
+    request->lastSent = 0;
+    return S_OK;
+}
+
+HRESULT SimConnect_MapClientEventToSimEvent(HANDLE hSimConnect, SIMCONNECT_CLIENT_EVENT_ID EventID, const char* EventName)
+{
+    return S_OK;
+}
+
+HRESULT SimConnect_TransmitClientEvent(HANDLE hSimConnect, SIMCONNECT_OBJECT_ID ObjectID, SIMCONNECT_CLIENT_EVENT_ID EventID, DWORD dwData,
+    SIMCONNECT_NOTIFICATION_GROUP_ID GroupID, SIMCONNECT_EVENT_FLAG Flags)
+{
+    return S_OK;
+}
+
+HRESULT SimConnect_MapClientDataNameToID(HANDLE hSimConnect, const char* szClientDataName, SIMCONNECT_CLIENT_DATA_ID ClientDataID)
+{
+    if (fakeSim.areaCount == MaxFakeAreas) {
+        return -1;
+    }
+
+    FakeArea* area = &fakeSim.areas[fakeSim.areaCount];
+    fakeSim.areaCount++;
+    area->areaId = ClientDataID;
+    area->isUplink = strstr(szClientDataName, "uplink") != NULL;
+    return S_OK;
+}
+
+HRESULT SimConnect_AddToClientDataDefinition(HANDLE hSimConnect, SIMCONNECT_CLIENT_DATA_DEFINITION_ID DefineID, DWORD dwOffset, DWORD dwSizeOrType,
+    float fEpsilon, DWORD DatumID)
+{
+    if (dwOffset + dwSizeOrType > MaxClientDataSize) {
+        return -1;
+    }
+
+    fakeSim.clientDefSize = dwOffset + dwSizeOrType;
+    return S_OK;
+}
+
+HRESULT SimConnect_RequestClientData(HANDLE hSimConnect, SIMCONNECT_CLIENT_DATA_ID ClientDataID, SIMCONNECT_DATA_REQUEST_ID RequestID,
+    SIMCONNECT_CLIENT_DATA_DEFINITION_ID DefineID, SIMCONNECT_CLIENT_DATA_PERIOD Period, SIMCONNECT_CLIENT_DATA_REQUEST_FLAG Flags,
+    DWORD origin, DWORD interval, DWORD limit)
+{
+    fakeSim.downlinkRequestId = RequestID;
+    fakeSim.downlinkDefineId = DefineID;
+    fakeSim.hasDownlink = true;
+    return S_OK;
+}
+
+/// <summary>
+/// Acts like the Jetbridge module. A packet on the uplink (an id and
+/// some RPN code) is answered on the downlink with the same id and the
+/// code followed by the result, which is always 0 here. Like the real
+/// module, writes are answered too even though nobody wants the reply.
+/// </summary>
+HRESULT SimConnect_SetClientData(HANDLE hSimConnect, SIMCONNECT_CLIENT_DATA_ID ClientDataID, SIMCONNECT_CLIENT_DATA_DEFINITION_ID DefineID,
+    SIMCONNECT_CLIENT_DATA_SET_FLAG Flags, DWORD dwReserved, DWORD cbUnitSize, void* pDataSet)
+{
+    bool isUplink = false;
+    for (int i = 0; i < fakeSim.areaCount; i++) {
+        if (fakeSim.areas[i].areaId == ClientDataID) {
+            isUplink = fakeSim.areas[i].isUplink;
+        }
+    }
+
+    if (!isUplink || !fakeSim.hasDownlink || cbUnitSize > MaxClientDataSize || cbUnitSize <= sizeof(int)) {
+        return S_OK;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fakeSim.replyLock);
+        if (fakeSim.replyCount == MaxFakeReplies) {
+            return S_OK;
+        }
+
+        FakeReply* reply = &fakeSim.replies[fakeSim.replyCount];
+        fakeSim.replyCount++;
+        reply->size = cbUnitSize;
+        memcpy(reply->data, pDataSet, cbUnitSize);
+
+        // Data follows the packet id
+        char* code = &reply->data[sizeof(int)];
+        int codeSize = cbUnitSize - sizeof(int);
+        int codeLen = strnlen(code, codeSize);
+        if (codeLen + 1 < codeSize) {
+            code[codeLen] = '0';
+            code[codeLen + 1] = '\0';
+        }
+    }
+
+    SetEvent(fakeSim.event);
+    return S_OK;
+}
@@ -0,0 +1,8 @@
+#ifndef _POSIX_TCHAR_H_
+#define _POSIX_TCHAR_H_
+
+// Stands in for tchar.h when building on Linux (always narrow chars)
+typedef char _TCHAR;
+#define _tmain main
+
+#endif // _POSIX_TCHAR_H_
@@ -0,0 +1,215 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <atomic>
+#include "windows.h"
+
+// An event is a pipe with a byte in it while it is signalled. An event
+// selected onto a socket is signalled whenever the socket is readable
+// instead, just like a WSAEVENT with FD_READ.
+struct PosixEvent {
+    int readFd;
+    int writeFd;
+    bool manualReset;
+    std::atomic<bool> signalled;
+    SOCKET sock;
+};
+
+static int lastError(int error)
+{
+    if (error == EWOULDBLOCK || error == EAGAIN) {
+        return WSAEWOULDBLOCK;
+    }
+    if (error == EMSGSIZE) {
+        return WSAEMSGSIZE;
+    }
+    return error;
+}
+
+HANDLE CreateEvent(void* attributes, BOOL manualReset, BOOL initialState, const char* name)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return NULL;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+    PosixEvent* event = new PosixEvent;
+    event->readFd = fds[0];
+    event->writeFd = fds[1];
+    event->manualReset = manualReset != FALSE;
+    event->signalled = false;
+    event->sock = INVALID_SOCKET;
+
+    if (initialState) {
+        SetEvent(event);
+    }
+    return event;
+}
+
+BOOL SetEvent(HANDLE handle)
+{
+    PosixEvent* event = (PosixEvent*)handle;
+    if (!event->signalled.exchange(true)) {
+        char signal = 1;
+        if (write(event->writeFd, &signal, 1) != 1) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE handle)
+{
+    PosixEvent* event = (PosixEvent*)handle;
+    if (event->signalled.exchange(false)) {
+        char signal;
+        while (read(event->readFd, &signal, 1) == 1) {
+        }
+    }
+    return TRUE;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    PosixEvent* event = (PosixEvent*)handle;
+    close(event->readFd);
+    close(event->writeFd);
+    delete event;
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD millis)
+{
+    return WaitForMultipleObjects(1, &handle, FALSE, millis);
+}
+
+/// <summary>
+/// Only waiting for any one of the objects is supported.
+/// </summary>
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD millis)
+{
+    const int MaxHandles = 8;
+    pollfd fds[MaxHandles];
+
+    if (count > MaxHandles || waitAll) {
+        return WAIT_FAILED;
+    }
+
+    for (DWORD i = 0; i < count; i++) {
+        PosixEvent* event = (PosixEvent*)handles[i];
+        fds[i].fd = event->sock == INVALID_SOCKET ? event->readFd : event->sock;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    ULONGLONG deadline = GetTickCount64() + millis;
+    while (true) {
+        int timeout = -1;
+        if (millis != INFINITE) {
+            ULONGLONG now = GetTickCount64();
+            timeout = now < deadline ? (int)(deadline - now) : 0;
+        }
+
+        int res = poll(fds, count, timeout);
+        if (res < 0 && errno != EINTR) {
+            return WAIT_FAILED;
+        }
+        if (res == 0) {
+            return WAIT_TIMEOUT;
+        }
+
+        for (DWORD i = 0; i < count; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+
+            PosixEvent* event = (PosixEvent*)handles[i];
+            if (event->sock != INVALID_SOCKET || event->manualReset) {
+                return WAIT_OBJECT_0 + i;
+            }
+
+            // Auto reset so only one wait sees it. The byte may also be
+            // left over from a signal that has already been taken.
+            bool signalled = event->signalled.exchange(false);
+            char signal;
+            while (read(event->readFd, &signal, 1) == 1) {
+            }
+            if (signalled || event->signalled.exchange(false)) {
+                return WAIT_OBJECT_0 + i;
+            }
+        }
+    }
+}
+
+void Sleep(DWORD millis)
+{
+    timespec delay;
+    delay.tv_sec = millis / 1000;
+    delay.tv_nsec = (millis % 1000) * 1000000L;
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+ULONGLONG GetTickCount64()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    count->QuadPart = (LONGLONG)now.tv_sec * 1000000000 + now.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* freq)
+{
+    freq->QuadPart = 1000000000;
+    return TRUE;
+}
+
+int WSAStartup(WORD version, WSADATA* data)
+{
+    data->wVersion = version;
+    return 0;
+}
+
+int WSACleanup()
+{
+    return 0;
+}
+
+int WSAGetLastError()
+{
+    return lastError(errno);
+}
+
+WSAEVENT WSACreateEvent()
+{
+    return CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+/// <summary>
+/// Like Winsock this also makes the socket non-blocking.
+/// </summary>
+int WSAEventSelect(SOCKET sock, WSAEVENT handle, long networkEvents)
+{
+    PosixEvent* event = (PosixEvent*)handle;
+    event->sock = sock;
+    return fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == -1 ? SOCKET_ERROR : 0;
+}
+
+BOOL WSAResetEvent(WSAEVENT handle)
+{
+    return ResetEvent(handle);
+}
+
+BOOL WSACloseEvent(WSAEVENT handle)
+{
+    return CloseHandle(handle);
+}
@@ -0,0 +1,131 @@
+#ifndef _POSIX_WINDOWS_H_
+#define _POSIX_WINDOWS_H_
+
+// Stands in for windows.h (and the Winsock it pulls in) when building
+// on Linux. Only the small part of Win32 the data link actually uses is
+// here. Events are pipes so they can be waited on with poll() alongside
+// sockets, which is how WaitForMultipleObjects handles a WSAEVENT.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef long HRESULT;
+typedef long LONG;
+typedef unsigned int UINT;
+typedef unsigned short WORD;
+typedef unsigned char BYTE;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef void* HANDLE;
+typedef void* HWND;
+
+typedef union {
+    struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+#define CALLBACK
+#define __cdecl
+#define FALSE 0
+#define TRUE 1
+#define S_OK 0
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define MAKEWORD(a, b) ((WORD)(((BYTE)(a)) | ((WORD)((BYTE)(b))) << 8))
+
+HANDLE CreateEvent(void* attributes, BOOL manualReset, BOOL initialState, const char* name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+BOOL CloseHandle(HANDLE handle);
+DWORD WaitForSingleObject(HANDLE handle, DWORD millis);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD millis);
+
+void Sleep(DWORD millis);
+ULONGLONG GetTickCount64();
+BOOL QueryPerformanceCounter(LARGE_INTEGER* count);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* freq);
+
+inline int _stricmp(const char* str1, const char* str2)
+{
+    return strcasecmp(str1, str2);
+}
+
+inline int _strnicmp(const char* str1, const char* str2, size_t count)
+{
+    return strncasecmp(str1, str2, count);
+}
+
+inline int sprintf_s(char* buffer, size_t size, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return len;
+}
+
+template <size_t size>
+int sprintf_s(char (&buffer)[size], const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return len;
+}
+
+// Winsock
+typedef int SOCKET;
+typedef sockaddr SOCKADDR;
+typedef HANDLE WSAEVENT;
+
+struct WSADATA {
+    WORD wVersion;
+};
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define FD_READ 1
+#define WSAEWOULDBLOCK 10035
+#define WSAEMSGSIZE 10040
+
+int WSAStartup(WORD version, WSADATA* data);
+int WSACleanup();
+int WSAGetLastError();
+WSAEVENT WSACreateEvent();
+int WSAEventSelect(SOCKET sock, WSAEVENT event, long networkEvents);
+BOOL WSAResetEvent(WSAEVENT event);
+BOOL WSACloseEvent(WSAEVENT event);
+
+inline int closesocket(SOCKET sock)
+{
+    return close(sock);
+}
+
+// Winsock takes the address length as an int
+inline int recvfrom(SOCKET sock, char* buf, int len, int flags, sockaddr* from, int* fromLen)
+{
+    socklen_t addrLen = *fromLen;
+    int bytes = (int)recvfrom(sock, buf, (size_t)len, flags, from, &addrLen);
+    *fromLen = addrLen;
+    return bytes;
+}
+
+#endif // _POSIX_WINDOWS_H_
@@ -0,0 +1,229 @@
+#include <string.h>
+#include <math.h>
+#include "aircraft.h"
+#include "jetbridge.h"
+
+extern SimVars simVars;
+
+bool isA310 = false;
+bool isFbw = false;
+bool isA320 = false;
+bool isA380 = false;
+bool is747 = false;
+bool isK100 = false;
+bool isPA28 = false;
+bool isAirliner = false;
+bool isNewAircraft = false;
+char prevAircraft[32] = "\0";
+double lastHeading = 0;
+int seatBeltsReplicateDelay = 0;
+LVars_A310 a310Vars;
+LVars_FBW fbwVars;
+
+/// <summary>
+/// Called with the aircraft title on every frame.
+/// </summary>
+void detectAircraft(const char* aircraft)
+{
+    isA310 = false;
+    isFbw = false;
+    isA320 = false;
+    isA380 = false;
+    is747 = false;
+    isK100 = false;
+    isPA28 = false;
+    isAirliner = false;
+    isNewAircraft = false;
+
+    if (strcmp(aircraft, prevAircraft) != 0) {
+        strcpy(prevAircraft, aircraft);
+        isNewAircraft = true;
+    }
+
+    const char* pos = strchr(aircraft, '3');
+    if (pos && *(pos - 1) == 'A') {
+        if (*(pos + 1) == '1') {
+            isA310 = true;
+            isAirliner = true;
+        }
+        else if (*(pos + 1) == '2') {
+            isFbw = true;
+            isA320 = true;
+            isAirliner = true;
+        }
+        else if (*(pos + 1) == '8') {
+            isFbw = true;
+            isA380 = true;
+            isAirliner = true;
+        }
+    }
+
+    if (strncmp(aircraft, "Salty", 5) == 0 || strncmp(aircraft, "Boeing 747-8", 12) == 0) {
+        is747 = true;
+        isAirliner = true;
+    }
+    else if (strncmp(aircraft, "Kodiak 100", 10) == 0) {
+        isK100 = true;
+    }
+    else if (strncmp(aircraft, "Just Flight PA28", 16) == 0) {
+        isPA28 = true;
+    }
+    else if (strncmp(aircraft, "Airbus", 6) == 0 || strncmp(aircraft, "Boeing", 6) == 0) {
+        isAirliner = true;
+    }
+}
+
+/// <summary>
+/// Map the current aircraft's own vars to real vars. Some aircraft
+/// need vars fixing or writing back to the sim too.
+/// </summary>
+void mapAircraftVars()
+{
+    if (abs(simVars.hiHeading - lastHeading) > 10) {
+        // Fix gyro if aircraft heading changes abruptly
+        //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_HEADING_GYRO_SET, 1, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+        writeJetbridgeVar(KEY_HEADING_GYRO_SET, 1);
+    }
+    lastHeading = simVars.hiHeading;
+
+    if (simVars.connected && isA310) {
+        // Map A310 vars to real vars
+        simVars.apuStartSwitch = a310Vars.apuStart;
+        if (a310Vars.apuStartAvail) {
+            simVars.apuPercentRpm = 100;
+        }
+        else {
+            simVars.apuPercentRpm = 0;
+        }
+
+        if (seatBeltsReplicateDelay > 0) {
+            seatBeltsReplicateDelay--;
+        }
+        else if (simVars.seatBeltsSwitch != a310Vars.seatbeltsSwitch) {
+            // Replicate lvar value back to standard SDK variable to make PACX work correctly
+            //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, 1, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+            writeJetbridgeVar(KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, 1);
+            seatBeltsReplicateDelay = 10;
+        }
+        simVars.seatBeltsSwitch = a310Vars.seatbeltsSwitch;
+        simVars.jbPitchTrim = a310Vars.pitchTrim1 + a310Vars.pitchTrim2;
+        simVars.autopilotAirspeed = a310Vars.autopilotAirspeed;
+        simVars.autopilotMach = a310Vars.autopilotAirspeed;
+        simVars.autopilotHeading = a310Vars.autopilotHeading;
+        simVars.autopilotAltitude = a310Vars.autopilotAltitude;
+        simVars.autopilotVerticalSpeed = a310Vars.autopilotVerticalSpeed;
+        simVars.tfAutoBrake = simVars.jbAutobrake + 1;
+        simVars.flightDirectorActive = a310Vars.flightDirector;
+        simVars.autopilotEngaged = a310Vars.autopilot;
+        simVars.autothrottleActive = a310Vars.autothrottle;
+        simVars.autopilotApproachHold = a310Vars.localiser;
+        simVars.autopilotGlideslopeHold = a310Vars.approach;
+        if (a310Vars.profile) {
+            simVars.jbManagedSpeed = 1;
+        }
+        else {
+            simVars.jbManagedSpeed = 0;
+        }
+        if (a310Vars.altHold || a310Vars.levelChange || a310Vars.profile) {
+            simVars.jbManagedAltitude = 0;  // For A310, managedAltitude == Selected VS
+        }
+        else {
+            simVars.jbManagedAltitude = 1;  // For A310, managedAltitude == Selected VS
+        }
+        if (a310Vars.gearHandle == 0 && simVars.gearLeftPos == 0 && simVars.gearCentrePos == 0 && simVars.gearRightPos == 0) {
+            // After gear up set handle to neutral position
+            writeJetbridgeVar(A310_GEAR_HANDLE, 1);
+        }
+        simVars.nav1Freq = a310Vars.ilsFrequency / 100;
+        simVars.nav1Standby = a310Vars.ilsFrequency / 100;
+        simVars.vor1Obs = a310Vars.ilsCourse;
+    }
+    else if (simVars.connected && isFbw) {
+        // Map FBW vars to real vars
+        simVars.apuStartSwitch = fbwVars.apuStart;
+        if (fbwVars.apuStartAvail) {
+            simVars.apuPercentRpm = 100;
+        }
+        else {
+            simVars.apuPercentRpm = 0;
+        }
+        simVars.tfFlapsIndex = fbwVars.flapsIndex;
+        simVars.parkingBrakeOn = fbwVars.parkBrakePos;
+        simVars.tfSpoilersPosition = fbwVars.spoilersHandlePos;
+        simVars.brakeLeftPedal = fbwVars.leftBrakePedal;
+        simVars.brakeRightPedal = fbwVars.rightBrakePedal;
+        simVars.rudderPosition = fbwVars.rudderPedalPos / 100.0;
+        simVars.autopilotEngaged = (fbwVars.autopilot1 == 0 && fbwVars.autopilot2 == 0) ? 0 : 1;
+        if (fbwVars.autothrust == 0) {
+            simVars.autothrottleActive = 0;
+        }
+        else {
+            simVars.autothrottleActive = 1;
+        }
+        simVars.transponderState = fbwVars.xpndrMode;
+        simVars.autopilotHeading = fbwVars.autopilotHeading;
+        simVars.autopilotAltitude = simVars.autopilotAltitude3;
+        simVars.autopilotVerticalSpeed = fbwVars.autopilotVerticalSpeed;
+        if (simVars.jbVerticalMode == 14) {
+            // V/S mode engaged
+            simVars.autopilotVerticalHold = 1;
+        }
+        else if (simVars.jbVerticalMode == 15) {
+            // FPA mode engaged
+            simVars.autopilotVerticalHold = -1;
+            simVars.autopilotVerticalSpeed = fbwVars.autopilotFpa;
+        }
+        else {
+            simVars.autopilotVerticalHold = 0;
+        }
+        simVars.autopilotApproachHold = simVars.jbLocMode;
+        simVars.autopilotGlideslopeHold = simVars.jbApprMode;
+        simVars.tfAutoBrake = simVars.jbAutobrake + 1;
+        simVars.exhaustGasTemp1 = fbwVars.engineEgt1;
+        simVars.exhaustGasTemp2 = fbwVars.engineEgt2;
+        simVars.engineFuelFlow1 = fbwVars.engineFuelFlow1;
+        simVars.engineFuelFlow2 = fbwVars.engineFuelFlow2;
+    }
+    else if (is747) {
+        // Map Salty 747 vars to real vars
+        simVars.autopilotAltitude = simVars.autopilotAltitude3;
+
+        // Slot index 1 = Selected, 2 = Managed
+        simVars.autopilotHeadingLock = simVars.autopilotHeadingSlotIndex == 1;
+        simVars.autopilotVerticalHold = simVars.autopilotVsSlotIndex == 1;
+
+        // B747 Bug - Fix initial autopilot altitude
+        if (simVars.altAboveGround < 50 && simVars.autopilotAltitude > 49900) {
+            // Set autopilot altitude to 5000
+            //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_AP_ALT_VAR_SET_ENGLISH, 5000, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+            writeJetbridgeVar(KEY_AP_ALT_VAR_SET_ENGLISH, 5000);
+        }
+
+        // B747 Bug - Fix master battery
+        if (simVars.batteryLoad > 1.2) {
+            if (simVars.elecBat1 == 0) {
+                simVars.elecBat1 = 1;
+                simVars.elecBat2 = 1;
+                printf("Batteries on, load: %f\n", simVars.batteryLoad);
+                fflush(stdout);
+            }
+        }
+        else if (simVars.batteryLoad > 0) {
+            // Ignore fake load 0.0 setting
+            if (simVars.elecBat1 == 1) {
+                simVars.elecBat1 = 0;
+                simVars.elecBat2 = 0;
+                printf("Batteries off, load: %f\n", simVars.batteryLoad);
+                fflush(stdout);
+            }
+        }
+    }
+    else {
+        simVars.elecBat1 = simVars.dcVolts > 0;
+    }
+
+    if (simVars.connected && isAirliner && simVars.engineFuelFlow1 > 0 && simVars.suctionPressure < 0.001) {
+        // Stop Annunciator reporting a vacuum fault on airliners
+        simVars.suctionPressure = 5;
+    }
+}
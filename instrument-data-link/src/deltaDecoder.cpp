@@ -0,0 +1,109 @@
+#include <string.h>
+#include "deltaDecoder.h"
+
+/// <summary>
+/// Apply a v1 delta (a list of DeltaDouble and DeltaString) to the
+/// panel's copy of the data. Returns false if the delta is corrupt.
+/// </summary>
+bool applyDelta(const char* data, long dataSize, SimVars* vars)
+{
+    char* varsPtr = (char*)vars;
+    long pos = 0;
+
+    while (pos < dataSize) {
+        int offset;
+        if (pos + (long)sizeof(int) > dataSize) {
+            return false;
+        }
+        memcpy(&offset, data + pos, sizeof(int));
+
+        if (offset & 0x10000) {
+            DeltaString deltaString;
+            offset &= 0xffff;
+            if (pos + (long)sizeof(DeltaString) > dataSize || offset + 32 > (long)sizeof(SimVars)) {
+                return false;
+            }
+            memcpy(&deltaString, data + pos, sizeof(DeltaString));
+            memcpy(varsPtr + offset, deltaString.data, 32);
+            pos += sizeof(DeltaString);
+        }
+        else {
+            DeltaDouble deltaDouble;
+            if (pos + (long)sizeof(DeltaDouble) > dataSize || offset + sizeof(double) > sizeof(SimVars)) {
+                return false;
+            }
+            memcpy(&deltaDouble, data + pos, sizeof(DeltaDouble));
+            memcpy(varsPtr + offset, &deltaDouble.data, sizeof(double));
+            pos += sizeof(DeltaDouble);
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Apply a v2 delta (header, changed bitmap then packed values) to the
+/// panel's copy of the data. Returns false if the delta is corrupt or
+/// was encoded for a different set of SimVarDefs.
+/// </summary>
+bool applyDeltaV2(const char* data, long dataSize, SimVars* vars, long* frameNo)
+{
+    DeltaHeaderV2 header;
+    if (dataSize < (long)sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.version != 2 || header.varCount > varCount) {
+        return false;
+    }
+
+    int bitmapSize = (header.varCount + 7) / 8;
+    const unsigned char* bitmap = (const unsigned char*)data + sizeof(header);
+    long pos = sizeof(header) + bitmapSize;
+    if (pos > dataSize) {
+        return false;
+    }
+
+    char* varsPtr = (char*)vars;
+    vars->connected = header.connected;
+
+    for (int i = 0; i < bitmapSize; i++) {
+        unsigned char bits = bitmap[i];
+        while (bits) {
+            int varNum = i * 8 + lowestBit(bits);
+            bits &= bits - 1;
+
+            if (varNum >= header.varCount) {
+                return false;
+            }
+
+            VarLayout* var = &varLayout[varNum];
+            if (var->kind == VAR_STRING32) {
+                if (pos >= dataSize) {
+                    return false;
+                }
+                int len = (unsigned char)data[pos];
+                if (len > 32 || pos + 1 + len > dataSize) {
+                    return false;
+                }
+                memset(varsPtr + var->offset, 0, 32);
+                memcpy(varsPtr + var->offset, data + pos + 1, len);
+                pos += 1 + len;
+            }
+            else {
+                if (pos + (long)sizeof(double) > dataSize) {
+                    return false;
+                }
+                memcpy(varsPtr + var->offset, data + pos, sizeof(double));
+                pos += sizeof(double);
+            }
+        }
+    }
+
+    if (frameNo) {
+        *frameNo = header.frameNo;
+    }
+
+    return pos == dataSize;
+}
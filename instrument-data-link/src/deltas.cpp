@@ -0,0 +1,422 @@
+#include <math.h>
+#include "deltas.h"
+
+struct CachedDelta {
+    long frameNo;       // Latest frame this delta was encoded for
+    unsigned long long changed[VarMaskSize];
+    long size[LIGHTS_PANEL + 1];
+    char data[MaxDeltaSize];
+
+    // V2 deltas can't be shared between panels (the bitmap length
+    // depends on the panel) so they are only encoded when needed.
+    long v2FrameNo[LIGHTS_PANEL + 1];
+    long v2Size[LIGHTS_PANEL + 1];
+    char v2Data[LIGHTS_PANEL + 1][MaxDeltaV2Size];
+};
+
+const int deltaDoubleSize = sizeof(DeltaDouble);
+const int deltaStringSize = sizeof(DeltaString);
+
+Frame frames[FrameHistory];
+int latest = 0;
+long nextFrameNo = 1;
+
+// Vars that changed in each frame, indexed by frameNo % ChangeHistory
+unsigned long long changeHistory[ChangeHistory][VarMaskSize];
+
+// Indexed by how many frames behind the panel is
+CachedDelta deltaCache[FrameHistory];
+
+// For a panel further behind than that. Panels that poll at the same
+// slow rate often share a baseline so the last one is kept.
+CachedDelta farDelta;
+long farBaseFrameNo = 0;
+
+// Number of vars each panel requests
+int panelVarCount[LIGHTS_PANEL + 1];
+
+// Vars that SimConnect doesn't own so must always be compared
+unsigned long long checkVars[VarMaskSize];
+
+static bool isChanged(const unsigned long long* changed, int varNum)
+{
+    return (changed[varNum / 64] & (1ULL << (varNum % 64))) != 0;
+}
+
+static void setChanged(unsigned long long* changed, int varNum)
+{
+    changed[varNum / 64] |= 1ULL << (varNum % 64);
+}
+
+static void addDeltaDouble(CachedDelta* delta, long* deltaSize, long offset, double newVal)
+{
+    DeltaDouble deltaDouble;
+    deltaDouble.offset = offset;
+    deltaDouble.data = newVal;
+
+    memcpy(delta->data + *deltaSize, &deltaDouble, deltaDoubleSize);
+    *deltaSize += deltaDoubleSize;
+}
+
+static void addDeltaString(CachedDelta* delta, long* deltaSize, long offset, char* newVal)
+{
+    DeltaString deltaString;
+    deltaString.offset = 0x10000 | offset;  // Set high bit so we know it is a string
+    strncpy(deltaString.data, newVal, 32);  // Only support string32
+
+    memcpy(delta->data + *deltaSize, &deltaString, deltaStringSize);
+    *deltaSize += deltaStringSize;
+}
+
+void deltasInit(SimVars* vars)
+{
+    for (int i = 0; i < FrameHistory; i++) {
+        frames[i].frameNo = 0;
+        frames[i].changed = changeHistory[0];
+        deltaCache[i].frameNo = 0;
+        for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+            deltaCache[i].v2FrameNo[panel] = 0;
+        }
+    }
+
+    farDelta.frameNo = 0;
+    farBaseFrameNo = 0;
+
+    for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+        panelVarCount[panel] = 0;
+        for (int i = 0; i < varCount; i++) {
+            if (varLayout[i].panelMask & (1 << panel)) {
+                panelVarCount[panel]++;
+            }
+        }
+    }
+
+    memset(checkVars, 0, sizeof(checkVars));
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        if ((var->kind != VAR_DOUBLE && var->kind != VAR_STRING32) || var->mapped || var->deadband != 0) {
+            setChanged(checkVars, i);
+        }
+    }
+
+    latest = 0;
+    snapshotFrame(vars);
+}
+
+/// <summary>
+/// Take a copy of the current data for the next frame. Returns false
+/// if this is the first frame, in which case every var is marked as
+/// changed.
+/// </summary>
+static bool startFrame(SimVars* vars, Frame** prevFramePtr, Frame** framePtr)
+{
+    Frame* prevFrame = &frames[latest];
+    latest = (latest + 1) % FrameHistory;
+    Frame* frame = &frames[latest];
+
+    memcpy(&frame->vars, vars, sizeof(SimVars));
+    frame->frameNo = nextFrameNo++;
+    frame->changed = changeHistory[frame->frameNo % ChangeHistory];
+    memset(frame->changed, 0, sizeof(changeHistory[0]));
+
+    *prevFramePtr = prevFrame;
+    *framePtr = frame;
+
+    if (prevFrame->frameNo == 0) {
+        for (int i = 0; i < varCount; i++) {
+            setChanged(frame->changed, i);
+        }
+        return false;
+    }
+
+    // Small changes to noisy vars are ignored so panels keep the value
+    // they were last sent until it moves beyond the deadband.
+    for (int i = 0; i < deadbandCount; i++) {
+        VarLayout* var = &varLayout[deadbandVars[i]];
+        double* oldVarPtr = (double*)((char*)&prevFrame->vars + var->offset);
+        double* newVarPtr = (double*)((char*)&frame->vars + var->offset);
+
+        if (fabs(*newVarPtr - *oldVarPtr) < var->deadband) {
+            *newVarPtr = *oldVarPtr;
+        }
+    }
+
+    return true;
+}
+
+static bool hasVarChanged(Frame* prevFrame, Frame* frame, VarLayout* var)
+{
+    char* oldVarPtr = (char*)&prevFrame->vars + var->offset;
+    char* newVarPtr = (char*)&frame->vars + var->offset;
+
+    if (var->kind == VAR_STRING32) {
+        // Ignore anything after the terminator
+        return strncmp(oldVarPtr, newVarPtr, 32) != 0;
+    }
+
+    return *(double*)oldVarPtr != *(double*)newVarPtr;
+}
+
+/// <summary>
+/// Take a copy of the current data and work out which vars have
+/// changed since the last frame. This is only done once per frame
+/// no matter how many panels are connected.
+/// </summary>
+void snapshotFrame(SimVars* vars)
+{
+    Frame* prevFrame;
+    Frame* frame;
+    if (!startFrame(vars, &prevFrame, &frame)) {
+        return;
+    }
+
+    // Find the 8 byte words that differ then map them to vars. A string
+    // spans several words so it is only compared once.
+    unsigned long long wordMask[WordMaskSize];
+    diffWords((double*)&prevFrame->vars, (double*)&frame->vars, wordCount, wordMask);
+
+    // Word 0 is 'connected' which is always sent
+    wordMask[0] &= ~1ULL;
+
+    for (int maskNum = 0; maskNum < WordMaskSize; maskNum++) {
+        unsigned long long bits = wordMask[maskNum];
+        while (bits) {
+            int varNum = wordVar[maskNum * 64 + lowestBit(bits)];
+            bits &= bits - 1;
+
+            if (isChanged(frame->changed, varNum)) {
+                continue;
+            }
+
+            VarLayout* var = &varLayout[varNum];
+            if (var->kind == VAR_STRING32 && !hasVarChanged(prevFrame, frame, var)) {
+                continue;
+            }
+
+            setChanged(frame->changed, varNum);
+        }
+    }
+}
+
+/// <summary>
+/// Same as snapshotFrame but SimConnect has already told us which vars
+/// it has sent (dirty) so only the vars it doesn't own need comparing.
+/// A dirty var is always sent, even if SimConnect sent the same value.
+/// </summary>
+void snapshotDirtyFrame(SimVars* vars, const unsigned long long* dirty)
+{
+    Frame* prevFrame;
+    Frame* frame;
+    if (!startFrame(vars, &prevFrame, &frame)) {
+        return;
+    }
+
+    for (int maskNum = 0; maskNum < VarMaskSize; maskNum++) {
+        frame->changed[maskNum] = dirty[maskNum] & ~checkVars[maskNum];
+
+        unsigned long long bits = checkVars[maskNum];
+        while (bits) {
+            int varNum = maskNum * 64 + lowestBit(bits);
+            bits &= bits - 1;
+
+            if (hasVarChanged(prevFrame, frame, &varLayout[varNum])) {
+                setChanged(frame->changed, varNum);
+            }
+        }
+    }
+}
+
+Frame* latestFrame()
+{
+    return &frames[latest];
+}
+
+/// <summary>
+/// Encode all the vars that have changed into the delta. Vars are
+/// added in offset order so a panel that only wants the first part
+/// of the data can just be sent the first part of the delta.
+/// </summary>
+static void encodeDelta(CachedDelta* delta, Frame* frame)
+{
+    unsigned long long* changed = delta->changed;
+    long deltaSize = 0;
+
+    // Always send 'connected' var
+    addDeltaDouble(delta, &deltaSize, 0, frame->vars.connected);
+    for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+        delta->size[panel] = deltaSize;
+    }
+
+    for (int maskNum = 0; maskNum < VarMaskSize; maskNum++) {
+        unsigned long long bits = changed[maskNum];
+        while (bits) {
+            int varNum = maskNum * 64 + lowestBit(bits);
+            bits &= bits - 1;
+
+            VarLayout* var = &varLayout[varNum];
+            char* newVarPtr = (char*)&frame->vars + var->offset;
+
+            if (var->kind == VAR_STRING32) {
+                addDeltaString(delta, &deltaSize, var->offset, newVarPtr);
+            }
+            else {
+                addDeltaDouble(delta, &deltaSize, var->offset, *(double*)newVarPtr);
+            }
+
+            for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+                if (var->panelMask & (1 << panel)) {
+                    delta->size[panel] = deltaSize;
+                }
+            }
+        }
+    }
+
+    delta->frameNo = frame->frameNo;
+}
+
+/// <summary>
+/// Encode a v2 delta for one panel. The bitmap only covers the vars
+/// the panel requested so the values that follow it are a prefix of
+/// the changed vars.
+/// </summary>
+static void encodeDeltaV2(CachedDelta* delta, Frame* frame, PANEL_TYPE panelType)
+{
+    char* data = delta->v2Data[panelType];
+    int panelVars = panelVarCount[panelType];
+    int bitmapSize = (panelVars + 7) / 8;
+
+    DeltaHeaderV2 header;
+    header.frameNo = frame->frameNo;
+    header.version = 2;
+    header.connected = frame->vars.connected != 0;
+    header.varCount = panelVars;
+    memcpy(data, &header, sizeof(header));
+
+    unsigned char* bitmap = (unsigned char*)data + sizeof(header);
+    memset(bitmap, 0, bitmapSize);
+    long deltaSize = sizeof(header) + bitmapSize;
+
+    for (int maskNum = 0; maskNum < VarMaskSize; maskNum++) {
+        unsigned long long bits = delta->changed[maskNum];
+        while (bits) {
+            int varNum = maskNum * 64 + lowestBit(bits);
+            bits &= bits - 1;
+
+            if (varNum >= panelVars) {
+                break;
+            }
+
+            VarLayout* var = &varLayout[varNum];
+            char* newVarPtr = (char*)&frame->vars + var->offset;
+            long valueSize;
+
+            if (var->kind == VAR_STRING32) {
+                valueSize = 1 + (long)strnlen(newVarPtr, 32);
+            }
+            else {
+                valueSize = sizeof(double);
+            }
+
+            if (deltaSize + valueSize >= MaxDeltaV2Size) {
+                // Too big to be worth sending
+                delta->v2Size[panelType] = MaxDeltaV2Size;
+                delta->v2FrameNo[panelType] = frame->frameNo;
+                return;
+            }
+
+            if (var->kind == VAR_STRING32) {
+                data[deltaSize] = (char)(valueSize - 1);
+                memcpy(data + deltaSize + 1, newVarPtr, valueSize - 1);
+            }
+            else {
+                memcpy(data + deltaSize, newVarPtr, sizeof(double));
+            }
+
+            bitmap[varNum / 8] |= 1 << (varNum % 8);
+            deltaSize += valueSize;
+        }
+    }
+
+    delta->v2Size[panelType] = deltaSize;
+    delta->v2FrameNo[panelType] = frame->frameNo;
+}
+
+/// <summary>
+/// Returns the vars that have changed between the panel's baseline
+/// frame and the latest frame or NULL if the baseline is unknown or
+/// older than the change history (so the panel needs full data). If
+/// the panel is more than one frame behind the changes from all the
+/// frames it has missed are merged together.
+/// </summary>
+static CachedDelta* mergeChanges(long baseFrameNo)
+{
+    Frame* frame = &frames[latest];
+    long behind = frame->frameNo - baseFrameNo;
+
+    if (baseFrameNo <= 0 || behind < 0 || behind >= ChangeHistory) {
+        return NULL;
+    }
+
+    CachedDelta* delta;
+    if (behind < FrameHistory) {
+        delta = &deltaCache[behind];
+    }
+    else {
+        delta = &farDelta;
+        if (farBaseFrameNo != baseFrameNo) {
+            farBaseFrameNo = baseFrameNo;
+            delta->frameNo = 0;
+            for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+                delta->v2FrameNo[panel] = 0;
+            }
+        }
+    }
+
+    if (delta->frameNo != frame->frameNo) {
+        memset(delta->changed, 0, sizeof(delta->changed));
+
+        for (long frameNo = baseFrameNo + 1; frameNo <= frame->frameNo; frameNo++) {
+            unsigned long long* missed = changeHistory[frameNo % ChangeHistory];
+            for (int j = 0; j < VarMaskSize; j++) {
+                delta->changed[j] |= missed[j];
+            }
+        }
+
+        encodeDelta(delta, frame);
+    }
+
+    return delta;
+}
+
+/// <summary>
+/// Returns the delta that takes a panel from its baseline frame to
+/// the latest frame or NULL if the panel needs full data.
+/// </summary>
+const char* getDelta(long baseFrameNo, PANEL_TYPE panelType, long* deltaSize)
+{
+    CachedDelta* delta = mergeChanges(baseFrameNo);
+    if (!delta) {
+        return NULL;
+    }
+
+    *deltaSize = delta->size[panelType];
+    return delta->data;
+}
+
+/// <summary>
+/// Same as getDelta but returns a v2 (bitmap plus packed values) delta.
+/// </summary>
+const char* getDeltaV2(long baseFrameNo, PANEL_TYPE panelType, long* deltaSize)
+{
+    CachedDelta* delta = mergeChanges(baseFrameNo);
+    if (!delta) {
+        return NULL;
+    }
+
+    if (delta->v2FrameNo[panelType] != delta->frameNo) {
+        encodeDeltaV2(delta, &frames[latest], panelType);
+    }
+
+    *deltaSize = delta->v2Size[panelType];
+    return delta->v2Data[panelType];
+}
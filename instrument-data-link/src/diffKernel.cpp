@@ -0,0 +1,75 @@
+#include <string.h>
+#include "diffKernel.h"
+
+#if defined(__AVX__) || defined(__AVX2__)
+#define DIFF_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+const char* diffKernelName()
+{
+#if defined(DIFF_AVX)
+    return "AVX";
+#elif defined(DIFF_SSE2)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+
+void diffWordsScalar(const double* oldWords, const double* newWords, int wordCount, unsigned long long* wordMask)
+{
+    memset(wordMask, 0, WordMaskSize * sizeof(unsigned long long));
+
+    for (int i = 0; i < wordCount; i++) {
+        if (oldWords[i] != newWords[i]) {
+            wordMask[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+}
+
+void diffWords(const double* oldWords, const double* newWords, int wordCount, unsigned long long* wordMask)
+{
+#if defined(DIFF_AVX)
+    memset(wordMask, 0, WordMaskSize * sizeof(unsigned long long));
+
+    // 4 doubles per compare, lane bits never straddle a mask word
+    int i = 0;
+    for (; i + 4 <= wordCount; i += 4) {
+        __m256d oldVals = _mm256_loadu_pd(oldWords + i);
+        __m256d newVals = _mm256_loadu_pd(newWords + i);
+        int bits = _mm256_movemask_pd(_mm256_cmp_pd(oldVals, newVals, _CMP_NEQ_UQ));
+        if (bits) {
+            wordMask[i / 64] |= (unsigned long long)bits << (i % 64);
+        }
+    }
+
+    for (; i < wordCount; i++) {
+        if (oldWords[i] != newWords[i]) {
+            wordMask[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+#elif defined(DIFF_SSE2)
+    memset(wordMask, 0, WordMaskSize * sizeof(unsigned long long));
+
+    // 2 doubles per compare, lane bits never straddle a mask word
+    int i = 0;
+    for (; i + 2 <= wordCount; i += 2) {
+        __m128d oldVals = _mm_loadu_pd(oldWords + i);
+        __m128d newVals = _mm_loadu_pd(newWords + i);
+        int bits = _mm_movemask_pd(_mm_cmpneq_pd(oldVals, newVals));
+        if (bits) {
+            wordMask[i / 64] |= (unsigned long long)bits << (i % 64);
+        }
+    }
+
+    if (i < wordCount && oldWords[i] != newWords[i]) {
+        wordMask[i / 64] |= 1ULL << (i % 64);
+    }
+#else
+    diffWordsScalar(oldWords, newWords, wordCount, wordMask);
+#endif
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include "dispatchLoop.h"
+#include "timerWheel.h"
+#include "stageTiming.h"
+
+DispatchStats dispatchStats;
+
+/// <summary>
+/// Keep processing messages until quit is set. If the source isn't
+/// connected keep retrying. Messages are also drained when the wait
+/// times out so a source that dies without telling us is noticed.
+/// Timers (see timerWheel.h) are run by this loop too.
+///
+/// This is the only thread that talks to the source. Each pass does
+/// the work in priority order: queued writes first as a panel is
+/// waiting on them, then timers (which includes Jetbridge reads) and
+/// finally whatever the source has sent.
+/// </summary>
+void dispatchLoop(MessageSource* source, bool* quit)
+{
+    HANDLE event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    HANDLE events[2] = { event, source->wakeEvent };
+    DWORD eventCount = source->wakeEvent ? 2 : 1;
+    bool connected = false;
+    ULONGLONG nextRetry = 0;
+
+    timerWheelInit(GetTickCount64());
+
+    dispatchStats.wakeups = 0;
+    dispatchStats.timeouts = 0;
+    dispatchStats.messages = 0;
+
+    printf("Searching for %s...\n", source->name);
+
+    while (!*quit) {
+        DWORD timeout = DispatchIdleMillis;
+
+        if (!connected) {
+            ULONGLONG now = GetTickCount64();
+            if (now >= nextRetry) {
+                connected = source->connect(event);
+                nextRetry = now + DispatchRetryMillis;
+            }
+
+            if (!connected) {
+                // Nothing will signal the source event so just wait for wakeups
+                timeout = (DWORD)(nextRetry - now);
+            }
+        }
+
+        // Don't sleep past the next timer
+        unsigned long timerMillis = nextTimerMillis(GetTickCount64());
+        if (timerMillis < timeout) {
+            timeout = timerMillis;
+        }
+
+        DWORD res = WaitForMultipleObjects(eventCount, events, FALSE, timeout);
+        if (res == WAIT_OBJECT_0) {
+            dispatchStats.wakeups++;
+        }
+        else if (res != WAIT_OBJECT_0 + 1) {
+            dispatchStats.timeouts++;
+        }
+
+        // Writes may have been queued even if the source event woke us
+        if (res == WAIT_OBJECT_0 + 1 || (eventCount == 2 && WaitForSingleObject(source->wakeEvent, 0) == WAIT_OBJECT_0)) {
+            LONGLONG start = stageStart();
+            source->wakeup();
+            stageDone(STAGE_WRITES, start);
+        }
+
+        LONGLONG start = stageStart();
+        if (runTimers(GetTickCount64()) > 0) {
+            stageDone(STAGE_TIMERS, start);
+        }
+
+        if (!connected) {
+            continue;
+        }
+
+        start = stageStart();
+        int count = source->dispatch();
+        stageDone(STAGE_DISPATCH, start);
+        if (count < 0) {
+            connected = false;
+            nextRetry = GetTickCount64() + DispatchRetryMillis;
+            source->disconnected();
+            if (!*quit) {
+                printf("Searching for %s...\n", source->name);
+            }
+        }
+        else {
+            dispatchStats.messages += count;
+        }
+    }
+
+    CloseHandle(event);
+}
@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include "flightRecorder.h"
+#include "varLayout.h"
+
+const int MaxRecordWords = MaxRecordSize / sizeof(DWORD);
+const int MaxMaskWords = (MaxRecordWords + 31) / 32;
+const ULONGLONG RecordFlushMillis = 1000;
+
+// The last message for each request so only changes need storing
+struct RecordStream {
+    DWORD id;
+    DWORD requestId;
+    DWORD size;
+    DWORD data[MaxRecordWords];
+};
+
+struct StreamSet {
+    RecordStream streams[MaxRecordStreams];
+    int count;
+};
+
+FILE* recordFile = NULL;
+ULONGLONG recordStartMillis;
+ULONGLONG recordFlushedMillis;
+StreamSet recordStreams;
+DWORD recordBuffer[1 + MaxMaskWords + MaxRecordWords];
+
+FILE* replayFile = NULL;
+double speedFactor;
+HANDLE replayEvent;
+StreamSet replayStreams;
+RecordHeader nextRecord;
+bool haveNextRecord;
+DWORD replayBuffer[1 + MaxMaskWords + MaxRecordWords];
+std::thread replayTicker;
+std::atomic<bool> replayRunning(false);
+std::atomic<ULONGLONG> replayDueMillis(0);
+ReplayStats replayStats;
+
+static DWORD hashBytes(DWORD hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619;
+    }
+    return hash;
+}
+
+/// <summary>
+/// Anything that changes where a var ends up in a message or in
+/// SimVars changes the hash.
+/// </summary>
+static DWORD layoutHash()
+{
+    DWORD hash = 2166136261;
+
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        hash = hashBytes(hash, var->name, strlen(var->name) + 1);
+        if (var->units) {
+            hash = hashBytes(hash, var->units, strlen(var->units) + 1);
+        }
+        hash = hashBytes(hash, &var->offset, sizeof(var->offset));
+        hash = hashBytes(hash, &var->kind, sizeof(var->kind));
+        hash = hashBytes(hash, &var->rate, sizeof(var->rate));
+    }
+
+    return hash;
+}
+
+static int findStream(StreamSet* set, const SIMCONNECT_RECV* pData)
+{
+    const SIMCONNECT_RECV_SIMOBJECT_DATA* pObjData = (const SIMCONNECT_RECV_SIMOBJECT_DATA*)pData;
+
+    for (int i = 0; i < set->count; i++) {
+        if (set->streams[i].id == pData->dwID && set->streams[i].requestId == pObjData->dwRequestID) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/// <summary>
+/// Keep a copy of the message so the next one for the same request can
+/// be stored as changes. The recorder and replay both see the messages
+/// in the same order so they always agree on the stream numbers.
+/// </summary>
+static void rememberMessage(StreamSet* set, int stream, const SIMCONNECT_RECV* pData)
+{
+    if (stream == -1) {
+        if (set->count == MaxRecordStreams) {
+            return;
+        }
+
+        stream = set->count;
+        set->count++;
+        set->streams[stream].id = pData->dwID;
+        set->streams[stream].requestId = ((const SIMCONNECT_RECV_SIMOBJECT_DATA*)pData)->dwRequestID;
+    }
+
+    RecordStream* last = &set->streams[stream];
+    last->size = pData->dwSize;
+    memcpy(last->data, pData, pData->dwSize);
+}
+
+/// <summary>
+/// Stores the stream number, a mask with a bit set for each word that
+/// has changed and then just the words that have changed. Returns the
+/// number of bytes used.
+/// </summary>
+static DWORD encodeChanges(int stream, const DWORD* prev, const DWORD* data, int words, DWORD* out)
+{
+    int maskWords = (words + 31) / 32;
+    DWORD* mask = out + 1;
+    DWORD* changed = mask + maskWords;
+    int changedCount = 0;
+
+    out[0] = stream;
+    memset(mask, 0, maskWords * sizeof(DWORD));
+
+    for (int i = 0; i < words; i++) {
+        if (data[i] != prev[i]) {
+            mask[i / 32] |= 1u << (i % 32);
+            changed[changedCount] = data[i];
+            changedCount++;
+        }
+    }
+
+    return (1 + maskWords + changedCount) * sizeof(DWORD);
+}
+
+static bool applyChanges(DWORD* data, int words, const DWORD* in, DWORD inSize)
+{
+    int maskWords = (words + 31) / 32;
+    const DWORD* mask = in + 1;
+    const DWORD* changed = mask + maskWords;
+    const DWORD* end = in + inSize / sizeof(DWORD);
+
+    if (changed > end) {
+        return false;
+    }
+
+    for (int i = 0; i < words; i++) {
+        if (mask[i / 32] & (1u << (i % 32))) {
+            if (changed == end) {
+                return false;
+            }
+            data[i] = *changed;
+            changed++;
+        }
+    }
+
+    return true;
+}
+
+bool recorderOpen(const char* filename)
+{
+    recordFile = fopen(filename, "wb");
+    if (!recordFile) {
+        printf("Failed to create recording %s\n", filename);
+        return false;
+    }
+
+    RecordingHeader header;
+    memcpy(header.magic, RecordingMagic, sizeof(header.magic));
+    header.layoutHash = layoutHash();
+    header.simVarsSize = sizeof(SimVars);
+
+    if (fwrite(&header, sizeof(header), 1, recordFile) != 1) {
+        printf("Failed to write recording %s\n", filename);
+        fclose(recordFile);
+        recordFile = NULL;
+        return false;
+    }
+
+    recordStreams.count = 0;
+    recordStartMillis = GetTickCount64();
+    recordFlushedMillis = recordStartMillis;
+
+    printf("Recording to %s\n", filename);
+    return true;
+}
+
+/// <summary>
+/// Only var data and Jetbridge replies are recorded as that is all
+/// replay needs. Does nothing if not recording.
+/// </summary>
+void recordMessage(SIMCONNECT_RECV* pData)
+{
+    if (!recordFile) {
+        return;
+    }
+
+    if (pData->dwID != SIMCONNECT_RECV_ID_SIMOBJECT_DATA && pData->dwID != SIMCONNECT_RECV_ID_CLIENT_DATA) {
+        return;
+    }
+
+    if (pData->dwSize > MaxRecordSize) {
+        printf("Message too big to record: %lu bytes\n", (unsigned long)pData->dwSize);
+        return;
+    }
+
+    ULONGLONG now = GetTickCount64();
+    RecordHeader header;
+    header.millis = (DWORD)(now - recordStartMillis);
+    header.kind = RECORD_MESSAGE;
+    header.size = pData->dwSize;
+    const void* payload = pData;
+
+    int stream = findStream(&recordStreams, pData);
+    if (stream != -1 && recordStreams.streams[stream].size == pData->dwSize && pData->dwSize % sizeof(DWORD) == 0) {
+        DWORD size = encodeChanges(stream, recordStreams.streams[stream].data, (const DWORD*)pData, pData->dwSize / sizeof(DWORD), recordBuffer);
+        if (size < pData->dwSize) {
+            header.kind = RECORD_CHANGES;
+            header.size = size;
+            payload = recordBuffer;
+        }
+    }
+
+    if (fwrite(&header, sizeof(header), 1, recordFile) != 1 || fwrite(payload, header.size, 1, recordFile) != 1) {
+        printf("Failed to write recording, recording stopped\n");
+        recorderClose();
+        return;
+    }
+
+    rememberMessage(&recordStreams, stream, pData);
+
+    // Don't lose much if the program is killed
+    if (now - recordFlushedMillis > RecordFlushMillis) {
+        fflush(recordFile);
+        recordFlushedMillis = now;
+    }
+}
+
+void recorderClose()
+{
+    if (recordFile) {
+        fclose(recordFile);
+        recordFile = NULL;
+    }
+}
+
+/// <summary>
+/// Signals the replay event when the next message is due.
+/// </summary>
+static void replayTick()
+{
+    while (replayRunning) {
+        ULONGLONG due = replayDueMillis;
+        if (due != 0 && GetTickCount64() >= due && replayDueMillis.compare_exchange_strong(due, 0)) {
+            SetEvent(replayEvent);
+        }
+        Sleep(1);
+    }
+}
+
+static bool readNextRecord()
+{
+    haveNextRecord = fread(&nextRecord, sizeof(nextRecord), 1, replayFile) == 1;
+
+    if (haveNextRecord && nextRecord.size > sizeof(replayBuffer)) {
+        printf("Recording is corrupt\n");
+        haveNextRecord = false;
+    }
+
+    return haveNextRecord;
+}
+
+/// <summary>
+/// Returns the message for the record just read or NULL if the
+/// recording is corrupt.
+/// </summary>
+static SIMCONNECT_RECV* readMessage()
+{
+    if (fread(replayBuffer, 1, nextRecord.size, replayFile) != nextRecord.size) {
+        printf("Recording is truncated\n");
+        return NULL;
+    }
+
+    if (nextRecord.kind == RECORD_MESSAGE) {
+        SIMCONNECT_RECV* pData = (SIMCONNECT_RECV*)replayBuffer;
+        if (nextRecord.size < sizeof(SIMCONNECT_RECV_SIMOBJECT_DATA) || pData->dwSize != nextRecord.size) {
+            printf("Recording is corrupt\n");
+            return NULL;
+        }
+
+        rememberMessage(&replayStreams, findStream(&replayStreams, pData), pData);
+        return pData;
+    }
+
+    DWORD stream = replayBuffer[0];
+    if (nextRecord.kind != RECORD_CHANGES || nextRecord.size < sizeof(DWORD) || stream >= (DWORD)replayStreams.count) {
+        printf("Recording is corrupt\n");
+        return NULL;
+    }
+
+    RecordStream* last = &replayStreams.streams[stream];
+    if (!applyChanges(last->data, last->size / sizeof(DWORD), replayBuffer, nextRecord.size)) {
+        printf("Recording is corrupt\n");
+        return NULL;
+    }
+
+    replayStats.changes++;
+    return (SIMCONNECT_RECV*)last->data;
+}
+
+/// <summary>
+/// Speed is relative to the recording, e.g. 2 replays at twice the
+/// speed it was recorded at. A speed of 0 replays as fast as possible.
+/// The event is signalled whenever replayDispatch has more to do.
+/// </summary>
+bool replayOpen(const char* filename, double speed, HANDLE event)
+{
+    replayFile = fopen(filename, "rb");
+    if (!replayFile) {
+        printf("Failed to open recording %s\n", filename);
+        return false;
+    }
+
+    RecordingHeader header;
+    if (fread(&header, sizeof(header), 1, replayFile) != 1 || memcmp(header.magic, RecordingMagic, sizeof(header.magic)) != 0) {
+        printf("%s is not a recording\n", filename);
+        replayClose();
+        return false;
+    }
+
+    if (header.layoutHash != layoutHash() || header.simVarsSize != sizeof(SimVars)) {
+        printf("%s was recorded with different SimVarDefs\n", filename);
+        replayClose();
+        return false;
+    }
+
+    speedFactor = speed;
+    replayEvent = event;
+    replayStreams.count = 0;
+    replayStats.messages = 0;
+    replayStats.changes = 0;
+    replayStats.startMillis = GetTickCount64();
+    replayStats.recordedMillis = 0;
+    readNextRecord();
+
+    replayDueMillis = 0;
+    replayRunning = true;
+    if (speedFactor > 0) {
+        replayTicker = std::thread(replayTick);
+    }
+
+    SetEvent(replayEvent);
+    return true;
+}
+
+/// <summary>
+/// Go back to the start of the recording, e.g. to loop it. Returns
+/// false if there is nothing to replay.
+/// </summary>
+bool replayRewind()
+{
+    if (!replayFile || fseek(replayFile, sizeof(RecordingHeader), SEEK_SET) != 0) {
+        return false;
+    }
+
+    // The first message of each stream is always stored whole
+    replayStreams.count = 0;
+    replayStats.messages = 0;
+    replayStats.changes = 0;
+    replayStats.startMillis = GetTickCount64();
+    replayStats.recordedMillis = 0;
+    replayDueMillis = 0;
+
+    SetEvent(replayEvent);
+    return readNextRecord();
+}
+
+/// <summary>
+/// Pass every message that is due to the dispatch proc. Returns the
+/// number of messages or -1 once the recording has finished.
+/// </summary>
+int replayDispatch(DispatchProc dispatchProc)
+{
+    if (!haveNextRecord) {
+        return -1;
+    }
+
+    DWORD batchMillis = nextRecord.millis;
+    int count = 0;
+
+    while (haveNextRecord) {
+        if (speedFactor > 0) {
+            ULONGLONG due = replayStats.startMillis + (ULONGLONG)(nextRecord.millis / speedFactor);
+            if (due > GetTickCount64()) {
+                replayDueMillis = due;
+                return count;
+            }
+        }
+        else if (nextRecord.millis != batchMillis) {
+            // Flat out but still one batch of messages at a time so
+            // writes and timers get a look in between them.
+            SetEvent(replayEvent);
+            return count;
+        }
+
+        replayStats.recordedMillis = nextRecord.millis;
+        SIMCONNECT_RECV* pData = readMessage();
+        if (!pData) {
+            haveNextRecord = false;
+            break;
+        }
+
+        dispatchProc(pData, pData->dwSize, NULL);
+        replayStats.messages++;
+        count++;
+        readNextRecord();
+    }
+
+    // Come back to say it's finished
+    SetEvent(replayEvent);
+    return count;
+}
+
+void replayClose()
+{
+    if (replayRunning) {
+        replayRunning = false;
+        if (replayTicker.joinable()) {
+            replayTicker.join();
+        }
+
+        ULONGLONG elapsed = GetTickCount64() - replayStats.startMillis;
+        printf("Replayed %ld messages (%ld as changes) covering %.1f secs in %.1f secs\n",
+            replayStats.messages, replayStats.changes, replayStats.recordedMillis / 1000.0, elapsed / 1000.0);
+    }
+
+    if (replayFile) {
+        fclose(replayFile);
+        replayFile = NULL;
+    }
+}
@@ -0,0 +1,199 @@
+#include <math.h>
+#include "flightState.h"
+
+extern SimVars simVars;
+
+bool initiatedPushback = false;
+bool completedTakeOff = false;
+bool hasFlown = false;
+int onStandState = 0;
+
+/// <summary>
+/// Called on every frame once the aircraft's vars have been mapped.
+/// </summary>
+void updateFlightState()
+{
+    if (simVars.altAboveGround > 50) {
+        hasFlown = true;
+        simVars.landingRate = -999;
+
+        if (initiatedPushback) {
+            // Reset ground state
+            initiatedPushback = false;
+            onStandState = 0;
+        }
+
+        if (!completedTakeOff && simVars.altAltitude > 10000) {
+            completedTakeOff = true;
+        }
+    }
+    else if (completedTakeOff && simVars.elecBat1 == 0) {
+        printf("Reset flight (Battery off)\n");
+        fflush(stdout);
+        completedTakeOff = false;
+    }
+
+    if (!simVars.connected || simVars.elecBat1 == 0) {
+        hasFlown = false;
+        simVars.landingRate = -999;
+    }
+
+    // Record landing rate. TouchdownVs isn't accurate so use actual VS instead.
+    if (hasFlown && simVars.onGround && simVars.landingRate == -999) {
+        simVars.landingRate = abs(simVars.vsiVerticalSpeed);
+        if (simVars.landingRate != 0) {
+            printf("Landing Rate: %d FPM\n", (int)((simVars.landingRate * 60) + 0.5));
+        }
+    }
+}
+
+/// <summary>
+/// If an event button is pressed return either EVENT_NONE or the event (sound)
+/// that should be played depending on current aircraft state.
+/// </summary>
+EVENT_ID getCustomEvent(int eventNum)
+{
+    EVENT_ID event = EVENT_NONE;
+    bool isClimbing = simVars.vsiVerticalSpeed > 3;
+    bool isDescending = simVars.vsiVerticalSpeed < -3;
+
+    FLIGHT_PHASE phase = GROUND;
+    if (simVars.altAboveGround > 50) {
+        if (simVars.altAltitude < 10000) {
+            if (!completedTakeOff) {
+                phase = TAKEOFF;
+            }
+            else if (isClimbing) {
+                phase = GO_AROUND;
+            }
+            else {
+                phase = APPROACH;
+            }
+        }
+        else if (isClimbing) {
+            phase = CLIMB;
+        }
+        else if (isDescending) {
+            phase = DESCENT;
+        }
+        else {
+            phase = CRUISE;
+        }
+    }
+
+    switch (eventNum) {
+    case 1:
+        // Event button 1 pressed
+        switch (phase) {
+            case GROUND:
+                if (completedTakeOff) {
+                    // Landed
+                    if (simVars.parkingBrakeOn) {
+                        // Arrived at stand
+                        return EVENT_DOORS_FOR_DISEMBARK;
+                    }
+                    else {
+                        // Taxi in
+                        return EVENT_DOORS_TO_MANUAL;
+                    }
+                }
+                else if (simVars.pushbackState < 3) {
+                    // Pushing back
+                    return EVENT_DOORS_TO_AUTO;
+                }
+                else if (initiatedPushback) {
+                    // Completed pushback
+                    return EVENT_SEATS_FOR_TAKEOFF;
+                }
+                else if (simVars.parkingBrakeOn) {
+                    // Still on stand
+                    onStandState++;
+                    switch (onStandState) {
+                    case 1:
+                        return EVENT_DOORS_FOR_BOARDING;
+                    case 2:
+                        return EVENT_WELCOME_ON_BOARD;
+                    case 3:
+                        return EVENT_BOARDING_COMPLETE;
+                    }
+                }
+                return EVENT_NONE;
+            case TAKEOFF:
+                return EVENT_NONE;
+            case CLIMB:
+                return EVENT_START_SERVING;
+            case CRUISE:
+                return EVENT_START_SERVING;
+            case DESCENT:
+                return EVENT_NONE;
+            case APPROACH:
+                if (simVars.altAboveGround > 4000) {
+                    return EVENT_LANDING_PREPARE_CABIN;
+                }
+                else {
+                    return EVENT_SEATS_FOR_LANDING;
+                }
+            case GO_AROUND:
+                return EVENT_NONE;
+        }
+
+    case 2:
+        // Event button 2 pressed
+        switch (phase) {
+        case GROUND:
+            if (completedTakeOff) {
+                // Landed
+                if (simVars.parkingBrakeOn) {
+                    // Arrived at stand
+                    printf("Reset flight (Captain goodbye)\n");
+                    fflush(stdout);
+                    completedTakeOff = false;
+                    return EVENT_DISEMBARK;
+                }
+                else {
+                    // Taxi in
+                    return EVENT_REMAIN_SEATED;
+                }
+            }
+            else {
+                return simVars.pushbackState < 3 ? EVENT_PUSHBACK_STOP : EVENT_PUSHBACK_START;
+            }
+        case TAKEOFF:
+            // If not reached 10000ft but descending and button 2 pressed just assume short flight
+            if (!completedTakeOff && isDescending) {
+                completedTakeOff = true;
+                return EVENT_FINAL_DESCENT;
+            }
+            return EVENT_NONE;
+        case CLIMB:
+            if (simVars.seatBeltsSwitch == 1) {
+                return EVENT_TURBULENCE;
+            }
+            else {
+                return EVENT_NONE;
+            }
+        case CRUISE:
+            if (simVars.seatBeltsSwitch == 1) {
+                return EVENT_TURBULENCE;
+            }
+            else {
+                return EVENT_REACHED_CRUISE;
+            }
+        case DESCENT:
+            if (simVars.seatBeltsSwitch == 1) {
+                return EVENT_TURBULENCE;
+            }
+            else {
+                return EVENT_REACHED_TOD;
+            }
+        case APPROACH:
+            if (simVars.altAboveGround > 4000) {
+                return EVENT_FINAL_DESCENT;
+            }
+        case GO_AROUND:
+            return EVENT_GO_AROUND;
+        }
+    }
+
+    return EVENT_NONE;
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "framePublish.h"
+#include "stageTiming.h"
+
+const int FreshFrame = 4;
+
+PublishedFrame publishedFrames[3];
+std::atomic<int> middleFrame;
+int backFrame;      // Only used by SimConnect thread
+int frontFrame;     // Only used by server thread
+long publishedCount = 0;
+
+// Vars SimConnect has sent that the server hasn't taken yet
+std::atomic<unsigned long long> dirtyVars[VarMaskSize];
+
+void publishInit(SimVars* vars)
+{
+    for (int i = 0; i < 3; i++) {
+        publishedFrames[i].simFrame = 0;
+        publishedFrames[i].publishedTime = stageStart();
+        memcpy(&publishedFrames[i].vars, vars, sizeof(SimVars));
+    }
+
+    for (int i = 0; i < VarMaskSize; i++) {
+        dirtyVars[i] = 0;
+    }
+
+    frontFrame = 0;
+    middleFrame = 1;
+    backFrame = 2;
+    publishedCount = 0;
+}
+
+/// <summary>
+/// Called by the SimConnect thread when a frame is complete. Dirty is
+/// the vars SimConnect sent for this frame (or NULL). They are only made
+/// visible after the frame so the server can't see a dirty var before
+/// the frame that contains its new value.
+/// </summary>
+void publishFrame(SimVars* vars, const unsigned long long* dirty)
+{
+    PublishedFrame* frame = &publishedFrames[backFrame];
+    frame->simFrame = ++publishedCount;
+    memcpy(&frame->vars, vars, sizeof(SimVars));
+    frame->publishedTime = stageStart();
+
+    backFrame = middleFrame.exchange(backFrame | FreshFrame) & ~FreshFrame;
+
+    if (dirty) {
+        for (int i = 0; i < VarMaskSize; i++) {
+            if (dirty[i]) {
+                dirtyVars[i] |= dirty[i];
+            }
+        }
+    }
+}
+
+bool isFrameWaiting()
+{
+    return (middleFrame.load() & FreshFrame) != 0;
+}
+
+/// <summary>
+/// Called by the server thread to get the latest frame. If dirty isn't
+/// NULL it is set to the vars SimConnect has sent since the last call.
+/// A var may be reported one frame late but is never missed.
+/// </summary>
+PublishedFrame* takeFrame(unsigned long long* dirty)
+{
+    if (dirty) {
+        for (int i = 0; i < VarMaskSize; i++) {
+            dirty[i] = dirtyVars[i].exchange(0);
+        }
+    }
+
+    if (isFrameWaiting()) {
+        frontFrame = middleFrame.exchange(frontFrame) & ~FreshFrame;
+    }
+
+    return &publishedFrames[frontFrame];
+}
@@ -7,12 +7,24 @@
 #include <tchar.h>
 #include <stdio.h>
 #include <thread>
+#include <atomic>
 #include "simvarDefs.h"
 #include "LVars-A310.h"
 #include "LVars-Fbw.h"
 #include "LVars-Kodiak100.h"
 #include "jetbridge.h"
 #include "vjoy.h"
+#include "sessions.h"
+#include "deltas.h"
+#include "varLayout.h"
+#include "dispatchLoop.h"
+#include "framePublish.h"
+#include "writeQueue.h"
+#include "timerWheel.h"
+#include "stageTiming.h"
+#include "aircraft.h"
+#include "flightState.h"
+#include "flightRecorder.h"
 #include "SimConnect.h"
 
  // Data will be served on this port
@@ -21,12 +33,28 @@ const int Port = 52020;
 // Change the next line to false if you always want to send
 // full data across the network rather than deltas.
 const bool UseDeltas = true;
-const int MaxDataSize = 8192;
+
+// Change the next line to true to have SimConnect only send the vars
+// that have changed (tagged) rather than every var on every frame.
+const bool UseTaggedData = false;
+
+// SimConnect doesn't send tagged data if nothing has changed so
+// make sure jetbridge and internal vars still get updated.
+const ULONGLONG TaggedIdleMillis = 100;
 
 // Uncomment the next line to show network data usage.
 // This should be a lot lower when using deltas.
 //#define SHOW_NETWORK_USAGE
 
+// Uncomment the next line to show how long writes from panels
+// wait before they are sent to the sim.
+//#define SHOW_WRITE_LATENCY
+//#define SHOW_JETBRIDGE_STATS
+
+// Uncomment the next line to show how long each stage from the
+// sim to the panels takes (see stageTiming.h).
+//#define SHOW_STAGE_TIMINGS
+
 #ifdef SHOW_NETWORK_USAGE
 ULONGLONG networkStart = 0;
 long networkIn;
@@ -34,7 +62,9 @@ long networkOut;
 #endif
 
 // Comment the following line out if you don't have any Raspberry Pi Pico USB devices
+#ifdef _WIN32
 #define PICO_USB
+#endif
 
 #ifdef PICO_USB
 #include "game-controllers.h"
@@ -66,65 +96,58 @@ WINDOWINFO mfdInfo;
 bool g1000IsPrimary = false;
 #endif
 
-enum FLIGHT_PHASE {
-    GROUND,
-    TAKEOFF,
-    CLIMB,
-    CRUISE,
-    DESCENT,
-    APPROACH,
-    GO_AROUND
-};
-
 bool quit = false;
-bool initiatedPushback = false;
-bool completedTakeOff = false;
-bool hasFlown = false;
-int onStandState = 0;
 double skytrackState = 0;
-bool isA310 = false;
-bool isFbw = false;
-bool isA320 = false;
-bool isA380 = false;
-bool is747 = false;
-bool isK100 = false;
-bool isPA28 = false;
-bool isAirliner = false;
-bool isNewAircraft = false;
-char prevAircraft[32] = "\0";
-double lastHeading = 0;
-int seatBeltsReplicateDelay = 0;
 int fixedPushback = -1;
-LVars_A310 a310Vars;
-LVars_FBW fbwVars;
 HANDLE hSimConnect = NULL;
+char recordFilename[256] = "";
+char replayFilename[256] = "";
+double replaySpeed = 1;
+bool replayLoop = false;
+ULONGLONG replayedMillis = 0;   // Flight time replayed over every loop
+const ULONGLONG ReplayReportMillis = 600000;
 extern const char* versionString;
-extern const char* SimVarDefs[][2];
 extern WriteEvent WriteEvents[];
 
 SimVars simVars;
-double *varsStart;
-int varsSize;
+
+// Vars are split into one SimConnect data definition per read rate.
+// Each definition is a list of runs of vars that are next to each other
+// in SimVars so the received data can be copied to the right place.
+struct VarRun {
+    short offset;
+    short size;
+};
+
+struct ReadDef {
+    int size;
+    int runCount;
+    VarRun runs[MaxVars];
+};
+
+ReadDef readDefs[RATE_CHANGED + 1];
+
+// Vars SimConnect has sent since the last frame was published
+// (only used for tagged data).
+unsigned long long pendingDirty[VarMaskSize];
+ULONGLONG lastFrameMillis = 0;
+int simMessages = 0;
+
+// Signalled every time a new SimConnect frame has been published
+// so the server can snapshot it and push it to subscribed panels.
+// Created by _tmain before either thread uses it and only closed
+// once both have stopped.
+HANDLE frameEvent = NULL;
 
 // Some panels request less data to save bandwidth
 long writeDataSize = sizeof(WriteData);
-long instrumentsDataSize = sizeof(SimVars);
-long autopilotDataSize = (long)((LONG_PTR)(&simVars.autothrottleActive) + (long)sizeof(double) - (LONG_PTR)&simVars);
-long radioDataSize = (long)((LONG_PTR)(&simVars.transponderCode) + (long)sizeof(double) - (LONG_PTR)&simVars);
-long lightsDataSize = (long)((LONG_PTR)(&simVars.apuPercentRpm) + (long)sizeof(double) - (LONG_PTR)&simVars);
-
-char* deltaData;
-long deltaSize;
-char* prevInstrumentsData;
-char* prevAutopilotData;
-char* prevRadioData;
-char* prevLightsData;
+long instrumentsDataSize = panelDataSize(INSTRUMENT_PANEL);
+long autopilotDataSize = panelDataSize(AUTOPILOT_PANEL);
+long radioDataSize = panelDataSize(RADIO_PANEL);
+long lightsDataSize = panelDataSize(LIGHTS_PANEL);
 
 int active = -1;
 int bytes;
-bool autopilotPanelConnected = false;
-bool radioPanelConnected = false;
-bool lightsPanelConnected = false;
 SOCKET sockfd;
 sockaddr_in senderAddr;
 int addrSize = sizeof(senderAddr);
@@ -134,47 +157,223 @@ sockaddr_in posSendAddr;
 PosData posData;
 int posDataSize = sizeof(PosData);
 int posSkip = 0;
-const int deltaDoubleSize = sizeof(DeltaDouble);
-const int deltaStringSize = sizeof(DeltaString);
 
-// Create server thread
+// Started by _tmain once everything it shares with
+// the SimConnect thread has been initialised.
 void server();
-std::thread serverThread(server);
+std::thread serverThread;
 
 enum DEFINITION_ID {
-    DEF_READ_ALL
+    DEF_READ_FRAME = RATE_FRAME,
+    DEF_READ_SECOND = RATE_SECOND,
+    DEF_READ_CHANGED = RATE_CHANGED
 };
 
 enum REQUEST_ID {
-    REQ_ID
+    REQ_FRAME = RATE_FRAME,
+    REQ_SECOND = RATE_SECOND,
+    REQ_CHANGED = RATE_CHANGED,
+    REQ_REFRESH_FRAME,      // One off reads of everything (tagged data only)
+    REQ_REFRESH_SECOND,
+    REQ_REFRESH_CHANGED
 };
 
 #ifdef jetbridgeFallback
-void pollJetbridge()
+// Each lvar is only read when it is due so this just
+// needs to be as often as the fastest rate.
+const unsigned long JetbridgePollMillis = 50;
+const unsigned long JetbridgeIdleMillis = 500;
+bool jetbridgePolling = false;
+
+/// <summary>
+/// Runs from a timer on the SimConnect thread so Jetbridge
+/// never uses the SimConnect handle from another thread.
+/// </summary>
+void pollJetbridge(int arg)
 {
-    // Use low frequency for jetbridge as vars not critical
-    int loopMillis = 100;
+    unsigned long delayMillis = JetbridgeIdleMillis;
 
-    while (!quit)
-    {
-        if (simVars.connected && isA310) {
-            readA310Jetbridge();
-            Sleep(loopMillis);
-        }
-        else if (simVars.connected && isFbw) {
-            readFbwJetbridge();
-            Sleep(loopMillis);
+    if (simVars.connected && isA310) {
+        readA310Jetbridge();
+        delayMillis = JetbridgePollMillis;
+    }
+    else if (simVars.connected && isFbw) {
+        readFbwJetbridge();
+        delayMillis = JetbridgePollMillis;
+    }
+
+    ULONGLONG now = GetTickCount64();
+
+#ifdef SHOW_JETBRIDGE_STATS
+    static ULONGLONG lastShown = 0;
+    if (now - lastShown > 2000 && simVars.connected) {
+        jetbridge::ClientStats stats = jetbridgeStats();
+        printf("Jetbridge: %d outstanding, %ld replies (Avg = %.1f ms, Max = %.0f ms), %ld timeouts, %ld refused, %ld unmatched, %ld write replies\n",
+            stats.outstanding, stats.replies, stats.replies > 0 ? stats.totalRoundTripMillis / stats.replies : 0,
+            stats.maxRoundTripMillis, stats.timeouts, stats.refused, stats.unmatched, stats.unwanted);
+        lastShown = now;
+    }
+#endif
+
+    // If this fails polling restarts on the next connect
+    jetbridgePolling = scheduleTimer(now, delayMillis, pollJetbridge, 0);
+}
+#endif
+
+void newFrame()
+{
+    if (UseTaggedData) {
+        publishFrame(&simVars, pendingDirty);
+        memset(pendingDirty, 0, sizeof(pendingDirty));
+    }
+    else {
+        publishFrame(&simVars, NULL);
+    }
+
+    SetEvent(frameEvent);
+}
+
+/// <summary>
+/// Tagged data is a list of var number (datum id) and value pairs for
+/// just the vars that have changed.
+/// </summary>
+void readTaggedData(SIMCONNECT_RECV* pData, SIMCONNECT_RECV_SIMOBJECT_DATA* pObjData)
+{
+    char* data = (char*)&pObjData->dwData;
+    char* dataEnd = (char*)pData + pObjData->dwSize;
+
+    for (DWORD i = 0; i < pObjData->dwDefineCount; i++) {
+        DWORD varNum;
+        memcpy(&varNum, data, sizeof(DWORD));
+        data += sizeof(DWORD);
+
+        if (varNum >= (DWORD)varCount || data + varLayout[varNum].size > dataEnd) {
+            printf("Error: SimConnect sent bad tagged data\n");
+            fflush(stdout);
+            break;
         }
-        else {
-            Sleep(500);
+
+        VarLayout* var = &varLayout[varNum];
+        memcpy((char*)&simVars + var->offset, data, var->size);
+        data += var->size;
+        pendingDirty[varNum / 64] |= 1ULL << (varNum % 64);
+    }
+}
+
+/// <summary>
+/// Copy the vars SimConnect has sent us into SimVars.
+/// </summary>
+void readData(SIMCONNECT_RECV* pData, SIMCONNECT_RECV_SIMOBJECT_DATA* pObjData)
+{
+    if (pObjData->dwFlags & SIMCONNECT_DATA_REQUEST_FLAG_TAGGED) {
+        readTaggedData(pData, pObjData);
+        return;
+    }
+
+    ReadDef* readDef = &readDefs[pObjData->dwRequestID];
+    int dataSize = pObjData->dwSize - (int)((char*)&pObjData->dwData - (char*)pData);
+
+    if (dataSize != readDef->size) {
+        printf("Error: SimConnect expected %d bytes but received %d bytes\n", readDef->size, dataSize);
+        fflush(stdout);
+        return;
+    }
+
+    char* data = (char*)&pObjData->dwData;
+    for (int i = 0; i < readDef->runCount; i++) {
+        VarRun* run = &readDef->runs[i];
+        memcpy((char*)&simVars + run->offset, data, run->size);
+        data += run->size;
+    }
+}
+
+/// <summary>
+/// Tagged data only sends vars that SimConnect thinks have changed. When
+/// the aircraft changes the mapped vars (see MappedVars) may have been
+/// overwritten by aircraft specific values, so ask for everything once
+/// to put the real values back.
+/// </summary>
+void refreshTaggedData()
+{
+    if (!hSimConnect) {
+        return;
+    }
+
+    for (int rate = 0; rate <= RATE_CHANGED; rate++) {
+        if (readDefs[rate].size > 0 && SimConnect_RequestDataOnSimObject(hSimConnect, (REQUEST_ID)(REQ_REFRESH_FRAME + rate), (DEFINITION_ID)rate,
+            SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_ONCE, SIMCONNECT_DATA_REQUEST_FLAG_TAGGED, 0, 0, 0) != 0) {
+            printf("Failed to refresh data\n");
         }
     }
 }
+
+/// <summary>
+/// Called every time there is a new frame of vars from SimConnect.
+/// </summary>
+void processFrame()
+{
+    static int displayDelay = 0;
+
+    lastFrameMillis = GetTickCount64();
+
+    // Populate internal variables
+    simVars.skytrackState = skytrackState;
+    detectAircraft(simVars.aircraft);
+    mapAircraftVars();
+    if (UseTaggedData && isNewAircraft) {
+        refreshTaggedData();
+    }
+    updateFlightState();
+
+#ifdef PICO_USB
+    // Populate simvars for Pico USB devices
+    picoRefresh();
+
+    if (isNewAircraft) {
+        simVars.sbMode = 0;     // Default to autopilot on switchbox
+    }
 #endif
 
+    if (fixedPushback != -1) {
+        // Pushback goes wrong sometimes (pushbackState == 4)
+        fixedPushback++;
+        if (fixedPushback == 20) {
+            if (simVars.pushbackState < 4) {
+                fixedPushback = -1;
+            }
+            else {
+                printf("Extra start pushback\n");
+                //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_TOGGLE_PUSHBACK, 0, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+                writeJetbridgeVar(KEY_TOGGLE_PUSHBACK, 0);
+            }
+        }
+        else if (fixedPushback == 40) {
+            fixedPushback = -1;
+            if (simVars.pushbackState < 3) {
+                printf("Extra stop pushback\n");
+                //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_TOGGLE_PUSHBACK, 0, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+                writeJetbridgeVar(KEY_TOGGLE_PUSHBACK, 0);
+            }
+        }
+    }
+
+    // Let the server know there is a new frame
+    newFrame();
+
+    //// For testing only - Leave commented out
+    //if (displayDelay > 0) {
+    //    displayDelay--;
+    //}
+    //else {
+    //    //printf("Aircraft: %s   Cruise Speed: %f\n", simVars.aircraft, simVars.cruiseSpeed);
+    //    displayDelay = 60;
+    //}
+}
+
 void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContext)
 {
-    static int displayDelay = 0;
+    simMessages++;
+    recordMessage(pData);
 
     switch (pData->dwID)
     {
@@ -215,287 +414,20 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
 
         switch (pObjData->dwRequestID)
         {
-        case REQ_ID:
+        case REQ_SECOND:
+        case REQ_CHANGED:
+        case REQ_REFRESH_FRAME:
+        case REQ_REFRESH_SECOND:
+        case REQ_REFRESH_CHANGED:
         {
-            int dataSize = pObjData->dwSize - ((int)(&pObjData->dwData) - (int)pData);
-            if (dataSize != varsSize) {
-                printf("Error: SimConnect expected %d bytes but received %d bytes\n", varsSize, dataSize);
-                fflush(stdout);
-            }
-            else {
-                memcpy(varsStart, &pObjData->dwData, varsSize);
-            }
-
-            // Populate internal variables
-            simVars.skytrackState = skytrackState;
-            isA310 = false;
-            isFbw = false;
-            isA320 = false;
-            isA380 = false;
-            is747 = false;
-            isK100 = false;
-            isPA28 = false;
-            isAirliner = false;
-            isNewAircraft = false;
-
-            if (strcmp(simVars.aircraft, prevAircraft) != 0) {
-                strcpy(prevAircraft, simVars.aircraft);
-                isNewAircraft = true;
-            }
-
-            char* pos = strchr(simVars.aircraft, '3');
-            if (pos && *(pos - 1) == 'A') {
-                if (*(pos + 1) == '1') {
-                    isA310 = true;
-                    isAirliner = true;
-                }
-                else if (*(pos + 1) == '2') {
-                    isFbw = true;
-                    isA320 = true;
-                    isAirliner = true;
-                }
-                else if (*(pos + 1) == '8') {
-                    isFbw = true;
-                    isA380 = true;
-                    isAirliner = true;
-                }
-            }
-
-            if (strncmp(simVars.aircraft, "Salty", 5) == 0 || strncmp(simVars.aircraft, "Boeing 747-8", 12) == 0) {
-                is747 = true;
-                isAirliner = true;
-            }
-            else if (strncmp(simVars.aircraft, "Kodiak 100", 10) == 0) {
-                isK100 = true;
-            }
-            else if (strncmp(simVars.aircraft, "Just Flight PA28", 16) == 0) {
-                isPA28 = true;
-            }
-            else if (strncmp(simVars.aircraft, "Airbus", 6) == 0 || strncmp(simVars.aircraft, "Boeing", 6) == 0) {
-                isAirliner = true;
-            }
-
-            if (abs(simVars.hiHeading - lastHeading) > 10) {
-                // Fix gyro if aircraft heading changes abruptly
-                //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_HEADING_GYRO_SET, 1, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
-                writeJetbridgeVar(KEY_HEADING_GYRO_SET, 1);
-            }
-            lastHeading = simVars.hiHeading;
-
-            if (simVars.connected && isA310) {
-                // Map A310 vars to real vars
-                simVars.apuStartSwitch = a310Vars.apuStart;
-                if (a310Vars.apuStartAvail) {
-                    simVars.apuPercentRpm = 100;
-                }
-                else {
-                    simVars.apuPercentRpm = 0;
-                }
-
-                if (seatBeltsReplicateDelay > 0) {
-                    seatBeltsReplicateDelay--;
-                }
-                else if (simVars.seatBeltsSwitch != a310Vars.seatbeltsSwitch) {
-                    // Replicate lvar value back to standard SDK variable to make PACX work correctly
-                    //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, 1, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
-                    writeJetbridgeVar(KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, 1);
-                    seatBeltsReplicateDelay = 10;
-                }
-                simVars.seatBeltsSwitch = a310Vars.seatbeltsSwitch;
-                simVars.jbPitchTrim = a310Vars.pitchTrim1 + a310Vars.pitchTrim2;
-                simVars.autopilotAirspeed = a310Vars.autopilotAirspeed;
-                simVars.autopilotMach = a310Vars.autopilotAirspeed;
-                simVars.autopilotHeading = a310Vars.autopilotHeading;
-                simVars.autopilotAltitude = a310Vars.autopilotAltitude;
-                simVars.autopilotVerticalSpeed = a310Vars.autopilotVerticalSpeed;
-                simVars.tfAutoBrake = simVars.jbAutobrake + 1;
-                simVars.flightDirectorActive = a310Vars.flightDirector;
-                simVars.autopilotEngaged = a310Vars.autopilot;
-                simVars.autothrottleActive = a310Vars.autothrottle;
-                simVars.autopilotApproachHold = a310Vars.localiser;
-                simVars.autopilotGlideslopeHold = a310Vars.approach;
-                if (a310Vars.profile) {
-                    simVars.jbManagedSpeed = 1;
-                }
-                else {
-                    simVars.jbManagedSpeed = 0;
-                }
-                if (a310Vars.altHold || a310Vars.levelChange || a310Vars.profile) {
-                    simVars.jbManagedAltitude = 0;  // For A310, managedAltitude == Selected VS
-                }
-                else {
-                    simVars.jbManagedAltitude = 1;  // For A310, managedAltitude == Selected VS
-                }
-                if (a310Vars.gearHandle == 0 && simVars.gearLeftPos == 0 && simVars.gearCentrePos == 0 && simVars.gearRightPos == 0) {
-                    // After gear up set handle to neutral position
-                    writeJetbridgeVar(A310_GEAR_HANDLE, 1);
-                }
-                simVars.nav1Freq = a310Vars.ilsFrequency / 100;
-                simVars.nav1Standby = a310Vars.ilsFrequency / 100;
-                simVars.vor1Obs = a310Vars.ilsCourse;
-            }
-            else if (simVars.connected && isFbw) {
-                // Map FBW vars to real vars
-                simVars.apuStartSwitch = fbwVars.apuStart;
-                if (fbwVars.apuStartAvail) {
-                    simVars.apuPercentRpm = 100;
-                }
-                else {
-                    simVars.apuPercentRpm = 0;
-                }
-                simVars.tfFlapsIndex = fbwVars.flapsIndex;
-                simVars.parkingBrakeOn = fbwVars.parkBrakePos;
-                simVars.tfSpoilersPosition = fbwVars.spoilersHandlePos;
-                simVars.brakeLeftPedal = fbwVars.leftBrakePedal;
-                simVars.brakeRightPedal = fbwVars.rightBrakePedal;
-                simVars.rudderPosition = fbwVars.rudderPedalPos / 100.0;
-                simVars.autopilotEngaged = (fbwVars.autopilot1 == 0 && fbwVars.autopilot2 == 0) ? 0 : 1;
-                if (fbwVars.autothrust == 0) {
-                    simVars.autothrottleActive = 0;
-                }
-                else {
-                    simVars.autothrottleActive = 1;
-                }
-                simVars.transponderState = fbwVars.xpndrMode;
-                simVars.autopilotHeading = fbwVars.autopilotHeading;
-                simVars.autopilotAltitude = simVars.autopilotAltitude3;
-                simVars.autopilotVerticalSpeed = fbwVars.autopilotVerticalSpeed;
-                if (simVars.jbVerticalMode == 14) {
-                    // V/S mode engaged
-                    simVars.autopilotVerticalHold = 1;
-                }
-                else if (simVars.jbVerticalMode == 15) {
-                    // FPA mode engaged
-                    simVars.autopilotVerticalHold = -1;
-                    simVars.autopilotVerticalSpeed = fbwVars.autopilotFpa;
-                }
-                else {
-                    simVars.autopilotVerticalHold = 0;
-                }
-                simVars.autopilotApproachHold = simVars.jbLocMode;
-                simVars.autopilotGlideslopeHold = simVars.jbApprMode;
-                simVars.tfAutoBrake = simVars.jbAutobrake + 1;
-                simVars.exhaustGasTemp1 = fbwVars.engineEgt1;
-                simVars.exhaustGasTemp2 = fbwVars.engineEgt2;
-                simVars.engineFuelFlow1 = fbwVars.engineFuelFlow1;
-                simVars.engineFuelFlow2 = fbwVars.engineFuelFlow2;
-            }
-            else if (is747) {
-                // Map Salty 747 vars to real vars
-                simVars.autopilotAltitude = simVars.autopilotAltitude3;
-
-                // Slot index 1 = Selected, 2 = Managed
-                simVars.autopilotHeadingLock = simVars.autopilotHeadingSlotIndex == 1;
-                simVars.autopilotVerticalHold = simVars.autopilotVsSlotIndex == 1;
-
-                // B747 Bug - Fix initial autopilot altitude
-                if (simVars.altAboveGround < 50 && simVars.autopilotAltitude > 49900) {
-                    // Set autopilot altitude to 5000
-                    //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_AP_ALT_VAR_SET_ENGLISH, 5000, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
-                    writeJetbridgeVar(KEY_AP_ALT_VAR_SET_ENGLISH, 5000);
-                }
-
-                // B747 Bug - Fix master battery
-                if (simVars.batteryLoad > 1.2) {
-                    if (simVars.elecBat1 == 0) {
-                        simVars.elecBat1 = 1;
-                        simVars.elecBat2 = 1;
-                        printf("Batteries on, load: %f\n", simVars.batteryLoad);
-                        fflush(stdout);
-                    }
-                }
-                else if (simVars.batteryLoad > 0) {
-                    // Ignore fake load 0.0 setting
-                    if (simVars.elecBat1 == 1) {
-                        simVars.elecBat1 = 0;
-                        simVars.elecBat2 = 0;
-                        printf("Batteries off, load: %f\n", simVars.batteryLoad);
-                        fflush(stdout);
-                    }
-                }
-            }
-            else {
-                simVars.elecBat1 = simVars.dcVolts > 0;
-            }
-
-            if (simVars.connected && isAirliner && simVars.engineFuelFlow1 > 0 && simVars.suctionPressure < 0.001) {
-                // Stop Annunciator reporting a vacuum fault on airliners
-                simVars.suctionPressure = 5;
-            }
-
-            if (simVars.altAboveGround > 50) {
-                hasFlown = true;
-                simVars.landingRate = -999;
-
-                if (initiatedPushback) {
-                    // Reset ground state
-                    initiatedPushback = false;
-                    onStandState = 0;
-                }
-
-                if (!completedTakeOff && simVars.altAltitude > 10000) {
-                    completedTakeOff = true;
-                }
-            }
-            else if (completedTakeOff && simVars.elecBat1 == 0) {
-                printf("Reset flight (Battery off)\n");
-                fflush(stdout);
-                completedTakeOff = false;
-            }
-#ifdef PICO_USB
-            // Populate simvars for Pico USB devices
-            picoRefresh();
-
-            if (isNewAircraft) {
-                simVars.sbMode = 0;     // Default to autopilot on switchbox
-            }
-#endif
-
-            if (fixedPushback != -1) {
-                // Pushback goes wrong sometimes (pushbackState == 4)
-                fixedPushback++;
-                if (fixedPushback == 20) {
-                    if (simVars.pushbackState < 4) {
-                        fixedPushback = -1;
-                    }
-                    else {
-                        printf("Extra start pushback\n");
-                        //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_TOGGLE_PUSHBACK, 0, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
-                        writeJetbridgeVar(KEY_TOGGLE_PUSHBACK, 0);
-                    }
-                }
-                else if (fixedPushback == 40) {
-                    fixedPushback = -1;
-                    if (simVars.pushbackState < 3) {
-                        printf("Extra stop pushback\n");
-                        //SimConnect_TransmitClientEvent(hSimConnect, 0, KEY_TOGGLE_PUSHBACK, 0, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
-                        writeJetbridgeVar(KEY_TOGGLE_PUSHBACK, 0);
-                    }
-                }
-            }
-
-            if (!simVars.connected || simVars.elecBat1 == 0) {
-                hasFlown = false;
-                simVars.landingRate = -999;
-            }
-
-            // Record landing rate. TouchdownVs isn't accurate so use actual VS instead.
-            if (hasFlown && simVars.onGround && simVars.landingRate == -999) {
-                simVars.landingRate = abs(simVars.vsiVerticalSpeed);
-                if (simVars.landingRate != 0) {
-                    printf("Landing Rate: %d FPM\n", (int)((simVars.landingRate * 60) + 0.5));
-                }
-            }
-
-            //// For testing only - Leave commented out
-            //if (displayDelay > 0) {
-            //    displayDelay--;
-            //}
-            //else {
-            //    //printf("Aircraft: %s   Cruise Speed: %f\n", simVars.aircraft, simVars.cruiseSpeed);
-            //    displayDelay = 60;
-            //}
-
+            // Slower vars get published with the next frame
+            readData(pData, pObjData);
+            break;
+        }
+        case REQ_FRAME:
+        {
+            readData(pData, pObjData);
+            processFrame();
             break;
         }
         default:
@@ -515,6 +447,12 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
 
         if (pClientData->dwRequestID == jetbridge::kDownlinkRequest) {
             auto packet = static_cast<jetbridge::Packet*>((jetbridge::Packet*)&pClientData->dwData);
+
+            // Replies are routed back to whoever made the request. Late
+            // replies are still worth having so try to match them by name.
+            if (jetbridgeReply(packet)) {
+                break;
+            }
             if (isA310) {
                 updateA310FromJetbridge(packet->data);
             }
@@ -537,56 +475,59 @@ void CALLBACK MyDispatchProc(SIMCONNECT_RECV* pData, DWORD cbData, void* pContex
     }
 }
 
-void addReadDefs()
+/// <summary>
+/// Remember where a var that has been added to a data definition
+/// needs to be copied to.
+/// </summary>
+void addToReadDef(ReadDef* readDef, VarLayout* var)
 {
-    varsStart = (double*)&simVars + 1;
-    varsSize = 0;
-    bool foundInternal = false;
+    VarRun* lastRun = readDef->runCount > 0 ? &readDef->runs[readDef->runCount - 1] : NULL;
 
-    for (int i = 0;; i++) {
-        if (SimVarDefs[i][0] == NULL) {
-            break;
-        }
+    if (lastRun && lastRun->offset + lastRun->size == var->offset) {
+        lastRun->size += var->size;
+    }
+    else {
+        VarRun* run = &readDef->runs[readDef->runCount];
+        run->offset = var->offset;
+        run->size = var->size;
+        readDef->runCount++;
+    }
 
-        if (_stricmp(SimVarDefs[i][1], "internal") == 0) {
-            foundInternal = true;
-        }
-        else if (foundInternal) {
-            printf("ERROR: Internal variables must come last. Cannot add: %s\n", SimVarDefs[i][0]);
-        }
-        else if (_strnicmp(SimVarDefs[i][1], "string", 6) == 0) {
-            // Add string
-            SIMCONNECT_DATATYPE dataType;
-            int dataLen;
+    readDef->size += var->size;
+}
 
-            if (strcmp(SimVarDefs[i][1], "string32") == 0) {
-                dataType = SIMCONNECT_DATATYPE_STRING32;
-                dataLen = 32;
-            }
-            else {
-                printf("Unsupported string type: %s\n", SimVarDefs[i][1]);
-                dataType = SIMCONNECT_DATATYPE_STRING32;
-                dataLen = 32;
-            }
+/// <summary>
+/// When replaying a recording there is no SimConnect but the read
+/// defs are still needed to unpack the data.
+/// </summary>
+void addReadDefs()
+{
+    for (int rate = 0; rate <= RATE_CHANGED; rate++) {
+        readDefs[rate].size = 0;
+        readDefs[rate].runCount = 0;
+    }
 
-            if (SimConnect_AddToDataDefinition(hSimConnect, DEF_READ_ALL, SimVarDefs[i][0], NULL, dataType) != 0) {
-                printf("Data def failed: %s (string)\n", SimVarDefs[i][0]);
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        ReadDef* readDef = &readDefs[var->rate];
+        DEFINITION_ID defId = (DEFINITION_ID)var->rate;
+
+        if (var->kind == VAR_STRING32) {
+            // Add string
+            if (hSimConnect && SimConnect_AddToDataDefinition(hSimConnect, defId, var->name, NULL, SIMCONNECT_DATATYPE_STRING32, 0, i) != 0) {
+                printf("Data def failed: %s (string)\n", var->name);
             }
             else {
-                varsSize += dataLen;
+                addToReadDef(readDef, var);
             }
         }
-        else if (_stricmp(SimVarDefs[i][1], "jetbridge") == 0) {
-            // SimConnect variables start after all Jetbridge variables
-            varsStart++;
-        }
-        else {
+        else if (var->kind == VAR_DOUBLE) {
             // Add double (float64)
-            if (SimConnect_AddToDataDefinition(hSimConnect, DEF_READ_ALL, SimVarDefs[i][0], SimVarDefs[i][1]) != 0) {
-                printf("Data def failed: %s, %s\n", SimVarDefs[i][0], SimVarDefs[i][1]);
+            if (hSimConnect && SimConnect_AddToDataDefinition(hSimConnect, defId, var->name, var->units, SIMCONNECT_DATATYPE_FLOAT64, 0, i) != 0) {
+                printf("Data def failed: %s, %s\n", var->name, var->units);
             }
             else {
-                varsSize += sizeof(double);
+                addToReadDef(readDef, var);
             }
         }
     }
@@ -610,11 +551,26 @@ void init()
     addReadDefs();
     mapEvents();
 
+    DWORD flags = 0;
+    if (UseTaggedData) {
+        flags = SIMCONNECT_DATA_REQUEST_FLAG_CHANGED | SIMCONNECT_DATA_REQUEST_FLAG_TAGGED;
+        memset(pendingDirty, 0, sizeof(pendingDirty));
+    }
+
     // Start requesting data
-    if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_ID, DEF_READ_ALL, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_VISUAL_FRAME, 0, 0, 0, 0) != 0) {
+    if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_FRAME, DEF_READ_FRAME, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_VISUAL_FRAME, flags, 0, 0, 0) != 0) {
         printf("Failed to start requesting data\n");
     }
 
+    if (readDefs[RATE_SECOND].size > 0 && SimConnect_RequestDataOnSimObject(hSimConnect, REQ_SECOND, DEF_READ_SECOND, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_SECOND, flags, 0, 0, 0) != 0) {
+        printf("Failed to start requesting data every second\n");
+    }
+
+    // Only sent when one of the vars changes
+    if (readDefs[RATE_CHANGED].size > 0 && SimConnect_RequestDataOnSimObject(hSimConnect, REQ_CHANGED, DEF_READ_CHANGED, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_VISUAL_FRAME, flags | SIMCONNECT_DATA_REQUEST_FLAG_CHANGED, 0, 0, 0) != 0) {
+        printf("Failed to start requesting changed data\n");
+    }
+
 #ifdef jetbridgeFallback
     jetbridgeInit(hSimConnect);
 #endif
@@ -623,8 +579,10 @@ void init()
 void cleanUp()
 {
     if (hSimConnect) {
-        if (SimConnect_RequestDataOnSimObject(hSimConnect, REQ_ID, DEF_READ_ALL, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_NEVER, 0, 0, 0, 0) != 0) {
-            printf("Failed to stop requesting data\n");
+        for (int rate = 0; rate <= RATE_CHANGED; rate++) {
+            if (readDefs[rate].size > 0 && SimConnect_RequestDataOnSimObject(hSimConnect, (REQUEST_ID)rate, (DEFINITION_ID)rate, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_NEVER, 0, 0, 0, 0) != 0) {
+                printf("Failed to stop requesting data\n");
+            }
         }
 
         printf("Disconnecting from MS FS2020\n");
@@ -637,506 +595,535 @@ void cleanUp()
     }
 
     // Wait for server to quit
-    serverThread.join();
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
+
+    if (frameEvent) {
+        CloseHandle(frameEvent);
+        frameEvent = NULL;
+    }
 
     WSACleanup();
     printf("Finished\n");
 }
 
-int __cdecl _tmain(int argc, _TCHAR* argv[])
+bool connectSim(HANDLE event)
 {
-    printf("Instrument Data Link %s Copyright (c) 2024 Scott Vincent\n", versionString);
-
-    // Yield so server can start
-    Sleep(100);
+    if (SimConnect_Open(&hSimConnect, "Instrument Data Link", NULL, 0, event, 0) != 0) {
+        return false;
+    }
 
-    printf("Searching for local MS FS2020...\n");
-    simVars.connected = 0;
+    printf("Connected to MS FS2020\n");
+    init();
+    simVars.connected = 1;
 
 #ifdef jetbridgeFallback
-    std::thread jetbridgeThread(pollJetbridge);
+    if (!jetbridgePolling) {
+        jetbridgePolling = scheduleTimer(GetTickCount64(), JetbridgePollMillis, pollJetbridge, 0);
+    }
 #endif
+    return true;
+}
 
-    HRESULT result;
-
-    int loopMillis = 10;
-    int retryDelay = 0;
-    while (!quit)
-    {
-        if (simVars.connected) {
-            result = SimConnect_CallDispatch(hSimConnect, MyDispatchProc, NULL);
-            if (result != 0) {
-                printf("Disconnected from MS FS2020\n");
-                simVars.connected = 0;
-                printf("Searching for local MS FS2020...\n");
-            }
-        }
-        else if (retryDelay > 0) {
-            retryDelay--;
-        }
-        else {
-            result = SimConnect_Open(&hSimConnect, "Instrument Data Link", NULL, 0, 0, 0);
-            if (result == 0) {
-                printf("Connected to MS FS2020\n");
-                init();
-                simVars.connected = 1;
-            }
-            else {
-                retryDelay = 200;
-            }
-        }
+int dispatchSim()
+{
+    simMessages = 0;
+    if (SimConnect_CallDispatch(hSimConnect, MyDispatchProc, NULL) != 0) {
+        return -1;
+    }
 
-        Sleep(loopMillis);
+    if (UseTaggedData && GetTickCount64() - lastFrameMillis > TaggedIdleMillis) {
+        processFrame();
     }
 
-#ifdef jetbridgeFallback
-    // Wait for thread to exit
-    jetbridgeThread.join();
+#ifdef SHOW_STAGE_TIMINGS
+    static ULONGLONG lastShown = 0;
+    ULONGLONG now = GetTickCount64();
+    if (now - lastShown > 2000) {
+        showStageTimings();
+        lastShown = now;
+    }
 #endif
 
-    cleanUp();
-    return 0;
+    return simMessages;
 }
 
-void addDeltaDouble(long offset, double newVal)
+void simDisconnected()
 {
-    DeltaDouble deltaDouble;
-    deltaDouble.offset = offset;
-    deltaDouble.data = newVal;
-
-    memcpy(deltaData + deltaSize, &deltaDouble, deltaDoubleSize);
-    deltaSize += deltaDoubleSize;
+    printf("Disconnected from MS FS2020\n");
+    simVars.connected = 0;
+    newFrame();
 }
 
-void addDeltaString(long offset, char *newVal)
+/// <summary>
+/// Replays a recording (see flightRecorder.h) in place of the sim.
+/// Panels can connect and write as normal but writes go nowhere.
+/// </summary>
+bool connectReplay(HANDLE event)
 {
-    DeltaString deltaString;
-    deltaString.offset = 0x10000 | offset;  // Set high bit so we know it is a string
-    strncpy(deltaString.data, newVal, 32);  // Only support string32
+    if (!replayOpen(replayFilename, replaySpeed, event)) {
+        quit = true;
+        return false;
+    }
+
+    if (replaySpeed > 0) {
+        printf("Replaying %s at %gx\n", replayFilename, replaySpeed);
+    }
+    else {
+        printf("Replaying %s as fast as possible\n", replayFilename);
+    }
 
-    memcpy(deltaData + deltaSize, &deltaString, deltaStringSize);
-    deltaSize += deltaStringSize;
+    addReadDefs();
+#ifdef jetbridgeFallback
+    jetbridgeInit(NULL);
+#endif
+    simVars.connected = 1;
+    return true;
 }
 
 /// <summary>
-/// Send the full set of data if this a new connection or we
-/// don't want to use deltas.
+/// Start the recording again straight away rather than going through
+/// a disconnect and reconnect, so a long run gets through as much
+/// flight as it can. Reports progress every 10 minutes of flight.
 /// </summary>
-void sendFull(char* prevSimVars, long dataSize)
+bool loopReplay()
 {
-    bytes = sendto(sockfd, (char*)&simVars, dataSize, 0, (SOCKADDR*)&senderAddr, addrSize);
-#ifdef SHOW_NETWORK_USAGE
-    networkOut += bytes;
-#endif
+    ULONGLONG before = replayedMillis;
+    replayedMillis += replayStats.recordedMillis;
+    if (replayedMillis / ReplayReportMillis != before / ReplayReportMillis) {
+        printf("Replayed %.1f hours of flight so far\n", replayedMillis / 3600000.0);
+    }
 
-    // Update prev data
-    memcpy(prevSimVars, &simVars, dataSize);
+    return replayRewind();
 }
 
-/// <summary>
-/// If this a new connection send all the data otherwise only send
-/// the delta, i.e. data that has changed since we last sent it.
-/// This should reduce network bandwidth usage hugely.
-/// </summary>
-void sendDelta(char* prevSimVars, long dataSize)
+int dispatchReplay()
 {
-    // Initialise delta data
-    deltaSize = 0;
+    simMessages = 0;
+    if (replayDispatch(MyDispatchProc) < 0 && (!replayLoop || !loopReplay())) {
+        return -1;
+    }
 
-    // Always send 'connected' var
-    addDeltaDouble(0, simVars.connected);
-    long offset = sizeof(double);
+    if (UseTaggedData && GetTickCount64() - lastFrameMillis > TaggedIdleMillis) {
+        processFrame();
+    }
 
-    // Add all vars that have changed to delta data
-    for (int i = 0;; i++) {
-        if (SimVarDefs[i][0] == NULL) {
-            break;
-        }
+    return simMessages;
+}
 
-        char* oldVarPtr = prevSimVars + offset;
-        char* newVarPtr = (char*)&simVars + offset;
+void replayFinished()
+{
+    replayClose();
+    simVars.connected = 0;
+    newFrame();
+    quit = true;
+}
 
-        if (_strnicmp(SimVarDefs[i][1], "string", 6) == 0) {
-            // Has string changed?
-            if (strncmp(oldVarPtr, newVarPtr, 32) != 0) {
-                addDeltaString(offset, newVarPtr);
-                memcpy(oldVarPtr, newVarPtr, 32);
-            }
+void processWrites();
+MessageSource simConnectSource = { "local MS FS2020", connectSim, dispatchSim, simDisconnected, NULL, processWrites };
+MessageSource replaySource = { "recording", connectReplay, dispatchReplay, replayFinished, NULL, processWrites };
+
+/// <summary>
+/// Args may be wide chars but file names are expected to be ASCII.
+/// </summary>
+void argString(char* buf, int bufSize, const _TCHAR* arg)
+{
+    int i = 0;
+    while (i < bufSize - 1 && arg[i] != 0) {
+        buf[i] = (char)arg[i];
+        i++;
+    }
+    buf[i] = '\0';
+}
+
+bool parseArgs(int argc, _TCHAR* argv[])
+{
+    char arg[256];
+
+    for (int i = 1; i < argc; i++) {
+        argString(arg, sizeof(arg), argv[i]);
 
-            offset += 32;
+        if (strcmp(arg, "--loop") == 0) {
+            replayLoop = true;
+            continue;
         }
-        else {
-            // Has double changed?
-            double* oldVar = (double*)oldVarPtr;
-            double* newVar = (double*)newVarPtr;
-            if (*oldVar != *newVar) {
-                addDeltaDouble(offset, *newVar);
-                memcpy(oldVarPtr, newVarPtr, sizeof(double));
-            }
 
-            offset += 8;
+        if (i + 1 == argc) {
+            return false;
         }
+        i++;
 
-        // Next variable
-        if (offset >= dataSize) {
-            break;
+        if (strcmp(arg, "--record") == 0) {
+            argString(recordFilename, sizeof(recordFilename), argv[i]);
+        }
+        else if (strcmp(arg, "--replay") == 0) {
+            argString(replayFilename, sizeof(replayFilename), argv[i]);
+        }
+        else if (strcmp(arg, "--speed") == 0) {
+            argString(arg, sizeof(arg), argv[i]);
+            replaySpeed = atof(arg);
+        }
+        else {
+            return false;
         }
     }
 
-    if (deltaSize < dataSize) {
-        // Send delta data
-        bytes = sendto(sockfd, (char*)deltaData, deltaSize, 0, (SOCKADDR*)&senderAddr, addrSize);
+    return true;
+}
+
+int __cdecl _tmain(int argc, _TCHAR* argv[])
+{
+    printf("Instrument Data Link %s Copyright (c) 2024 Scott Vincent\n", versionString);
+
+    if (!parseArgs(argc, argv)) {
+        printf("Usage: instrument-data-link [--record file] [--replay file [--speed n] [--loop]]\n");
+        printf("  Speed is relative to the recording, 0 = as fast as possible\n");
+        quit = true;
+        cleanUp();
+        return 1;
     }
-    else {
-        // Send full data
-        bytes = sendto(sockfd, (char*)&simVars, dataSize, 0, (SOCKADDR*)&senderAddr, addrSize);
+
+    simVars.connected = 0;
+
+    // Everything both threads use must exist before the server starts.
+    // Nothing can be sent if SimVarDefs doesn't match SimVars.
+    if (!varLayoutInit()) {
+        quit = true;
+        cleanUp();
+        return 1;
     }
+    writeQueueInit();
+    stageTimingInit();
+    publishInit(&simVars);
+    frameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    serverThread = std::thread(server);
+
+    if (*recordFilename != '\0' && !recorderOpen(recordFilename)) {
+        quit = true;
+    }
+
+    MessageSource* source = *replayFilename != '\0' ? &replaySource : &simConnectSource;
+    source->wakeEvent = writeQueueEvent();
+    dispatchLoop(source, &quit);
+
+    recorderClose();
+    cleanUp();
+    return 0;
+}
+
+/// <summary>
+/// Send the full set of data if this a new connection or we
+/// don't want to use deltas.
+/// </summary>
+void sendFull(sockaddr_in* addr, long dataSize)
+{
+    bytes = sendto(sockfd, (char*)&latestFrame()->vars, dataSize, 0, (SOCKADDR*)addr, addrSize);
 #ifdef SHOW_NETWORK_USAGE
     networkOut += bytes;
 #endif
 }
 
 /// <summary>
-/// If an event button is pressed return either EVENT_NONE or the event (sound)
-/// that should be played depending on current aircraft state.
+/// If this a new connection send all the data otherwise only send
+/// the delta, i.e. data that has changed since we last sent it.
+/// This should reduce network bandwidth usage hugely.
 /// </summary>
-EVENT_ID getCustomEvent(int eventNum)
+void sendDelta(Session* session, long dataSize)
 {
-    EVENT_ID event = EVENT_NONE;
-    bool isClimbing = simVars.vsiVerticalSpeed > 3;
-    bool isDescending = simVars.vsiVerticalSpeed < -3;
-
-    FLIGHT_PHASE phase = GROUND;
-    if (simVars.altAboveGround > 50) {
-        if (simVars.altAltitude < 10000) {
-            if (!completedTakeOff) {
-                phase = TAKEOFF;
-            }
-            else if (isClimbing) {
-                phase = GO_AROUND;
-            }
-            else {
-                phase = APPROACH;
-            }
+    long deltaSize;
+    const char* deltaData;
+
+    if (session->deltaV2) {
+        deltaData = getDeltaV2(session->frameNo, session->panelType, &deltaSize);
+    }
+    else {
+        deltaData = getDelta(session->frameNo, session->panelType, &deltaSize);
+    }
+
+    if (deltaData && deltaSize < dataSize) {
+        // Send delta data
+        bytes = sendto(sockfd, deltaData, deltaSize, 0, (SOCKADDR*)&session->addr, addrSize);
+#ifdef SHOW_NETWORK_USAGE
+        networkOut += bytes;
+#endif
+    }
+    else {
+        // Send full data
+        sendFull(&session->addr, dataSize);
+    }
+
+    session->frameNo = latestFrame()->frameNo;
+}
+
+/// <summary>
+/// Every panel has its own session so it gets its own delta baseline,
+/// even if another panel of the same type is also connected.
+/// </summary>
+void sendData(PANEL_TYPE panelType, long dataSize)
+{
+    Session* session = findSession(&senderAddr, panelType);
+    if (!session) {
+        // No session available so this panel can't have deltas
+        sendFull(&senderAddr, dataSize);
+        return;
+    }
+
+    int mode = request.wantFullData & RequestModeMask;
+    session->deltaV2 = (request.wantFullData & DeltaFormatV2) != 0;
+
+    if (mode == REQUEST_SUBSCRIBE) {
+        bool keepAlive = session->subscribed && session->connected;
+        subscribe(session, request.writeData.value);
+        if (keepAlive) {
+            // Already being pushed data
+            return;
         }
-        else if (isClimbing) {
-            phase = CLIMB;
+    }
+    else if (mode == REQUEST_UNSUBSCRIBE) {
+        session->subscribed = false;
+    }
+
+    if (!session->connected || mode == REQUEST_FULL || !UseDeltas) {
+        if (!session->connected) {
+            printf("%s connected from %s:%d\n", panelName(panelType), inet_ntoa(senderAddr.sin_addr), ntohs(senderAddr.sin_port));
+            session->connected = true;
         }
-        else if (isDescending) {
-            phase = DESCENT;
+        sendFull(&session->addr, dataSize);
+        session->frameNo = latestFrame()->frameNo;
+    }
+    else {
+        sendDelta(session, dataSize);
+    }
+
+    session->lastPush = GetTickCount64();
+}
+
+/// <summary>
+/// Called when there is a new SimConnect frame. Subscribed panels get
+/// sent the delta straight away (no need to wait for them to poll)
+/// unless they have asked for a lower update rate.
+/// </summary>
+void pushSubscriptions()
+{
+    ULONGLONG now = GetTickCount64();
+
+    for (int i = 0; i < MaxSessions; i++) {
+        Session* session = &sessions[i];
+
+        if (!session->inUse || !session->subscribed || !session->connected) {
+            continue;
+        }
+
+        if (now - session->lastPush < session->pushIntervalMillis) {
+            continue;
+        }
+
+        long dataSize = panelDataSize(session->panelType);
+        if (UseDeltas) {
+            sendDelta(session, dataSize);
         }
         else {
-            phase = CRUISE;
-        }
-    }
-
-    switch (eventNum) {
-    case 1:
-        // Event button 1 pressed
-        switch (phase) {
-            case GROUND:
-                if (completedTakeOff) {
-                    // Landed
-                    if (simVars.parkingBrakeOn) {
-                        // Arrived at stand
-                        return EVENT_DOORS_FOR_DISEMBARK;
-                    }
-                    else {
-                        // Taxi in
-                        return EVENT_DOORS_TO_MANUAL;
-                    }
-                }
-                else if (simVars.pushbackState < 3) {
-                    // Pushing back
-                    return EVENT_DOORS_TO_AUTO;
-                }
-                else if (initiatedPushback) {
-                    // Completed pushback
-                    return EVENT_SEATS_FOR_TAKEOFF;
-                }
-                else if (simVars.parkingBrakeOn) {
-                    // Still on stand
-                    onStandState++;
-                    switch (onStandState) {
-                    case 1:
-                        return EVENT_DOORS_FOR_BOARDING;
-                    case 2:
-                        return EVENT_WELCOME_ON_BOARD;
-                    case 3:
-                        return EVENT_BOARDING_COMPLETE;
-                    }
-                }
-                return EVENT_NONE;
-            case TAKEOFF:
-                return EVENT_NONE;
-            case CLIMB:
-                return EVENT_START_SERVING;
-            case CRUISE:
-                return EVENT_START_SERVING;
-            case DESCENT:
-                return EVENT_NONE;
-            case APPROACH:
-                if (simVars.altAboveGround > 4000) {
-                    return EVENT_LANDING_PREPARE_CABIN;
-                }
-                else {
-                    return EVENT_SEATS_FOR_LANDING;
-                }
-            case GO_AROUND:
-                return EVENT_NONE;
-        }
-
-    case 2:
-        // Event button 2 pressed
-        switch (phase) {
-        case GROUND:
-            if (completedTakeOff) {
-                // Landed
-                if (simVars.parkingBrakeOn) {
-                    // Arrived at stand
-                    printf("Reset flight (Captain goodbye)\n");
-                    fflush(stdout);
-                    completedTakeOff = false;
-                    return EVENT_DISEMBARK;
-                }
-                else {
-                    // Taxi in
-                    return EVENT_REMAIN_SEATED;
-                }
-            }
-            else {
-                return simVars.pushbackState < 3 ? EVENT_PUSHBACK_STOP : EVENT_PUSHBACK_START;
-            }
-        case TAKEOFF:
-            // If not reached 10000ft but descending and button 2 pressed just assume short flight
-            if (!completedTakeOff && isDescending) {
-                completedTakeOff = true;
-                return EVENT_FINAL_DESCENT;
-            }
-            return EVENT_NONE;
-        case CLIMB:
-            if (simVars.seatBeltsSwitch == 1) {
-                return EVENT_TURBULENCE;
-            }
-            else {
-                return EVENT_NONE;
-            }
-        case CRUISE:
-            if (simVars.seatBeltsSwitch == 1) {
-                return EVENT_TURBULENCE;
-            }
-            else {
-                return EVENT_REACHED_CRUISE;
-            }
-        case DESCENT:
-            if (simVars.seatBeltsSwitch == 1) {
-                return EVENT_TURBULENCE;
-            }
-            else {
-                return EVENT_REACHED_TOD;
-            }
-        case APPROACH:
-            if (simVars.altAboveGround > 4000) {
-                return EVENT_FINAL_DESCENT;
-            }
-        case GO_AROUND:
-            return EVENT_GO_AROUND;
+            sendFull(&session->addr, dataSize);
+            session->frameNo = latestFrame()->frameNo;
         }
-    }
 
-    return EVENT_NONE;
+        session->lastPush = now;
+    }
 }
 
-void processRequest(int bytes)
+/// <summary>
+/// Carry out a write that a panel has requested. Only called by the
+/// thread that owns SimConnect.
+/// </summary>
+void processWrite(WriteCommand* command)
 {
+    WriteData* writeData = &command->writeData;
+
+    if (writeData->eventId == KEY_ENG_CRANK) {
+        if (isA310) {
+            // 1 = Start A, 3 = Off
+            int value = 3;
+            if (writeData->value == 1) {
+                value = 1;
+            }
+            writeJetbridgeVar(A310_ENG_IGNITION, value);
+        }
+        return;
+    }
+
+    if (!simVars.connected) {
+        return;
+    }
+
     //// For testing only - Leave commented out
-    //if (request.requestedSize == writeDataSize) {
-    //    printf("Received %d bytes from %s - Write Request event: %s\n", bytes, inet_ntoa(senderAddr.sin_addr), WriteEvents[request.writeData.eventId].name);
+    //if (writeData->eventId == KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE) {
+    //    writeData->eventId = KEY_FLAPS_INCR;
+    //    writeData->value = 0;
+    //    printf("Intercepted event - Changed to: %d = %f\n", writeData->eventId, writeData->value);
+    //    printf("Flaps: %f\n", simVars.tfFlapsIndex);
+    //    writeJetbridgeVar("K:FLAPS HANDLE INDEX, number", simVars.tfFlapsIndex + 1.0f);
     //}
     //else {
-    //    // To  test you can send from client with this command: echo - e '\x1\x0\x0\x0' | ncat -u 192.168.1.80 52020
-    //    printf("Received %d bytes from %s - Requesting %d bytes\n", bytes, inet_ntoa(senderAddr.sin_addr), request.requestedSize);
+    //    printf("Unintercepted event: %d (%d) = %f\n", writeData->eventId, KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, writeData->value);
     //}
 
-    if (request.requestedSize == writeDataSize) {
-         // This is a write
-        if (request.writeData.eventId == KEY_ENG_CRANK) {
-            if (isA310) {
-                // 1 = Start A, 3 = Off
-                int value = 3;
-                if (request.writeData.value == 1) {
-                    value = 1;
-                }
-                writeJetbridgeVar(A310_ENG_IGNITION, value);
+    if (writeData->eventId >= VJOY_BUTTONS && writeData->eventId <= VJOY_BUTTONS_END) {
+        // Override vJoy anti ice buttons for A310
+        if (isA310) {
+            if (writeData->eventId == VJOY_BUTTON_13) {
+                // Anti ice on
+                RpnProgram program = {};
+                writeJetbridgeVar(&program, A310_ENG1_ANTI_ICE, 1);
+                writeJetbridgeVar(&program, A310_ENG2_ANTI_ICE, 1);
+                writeJetbridgeVar(&program, A310_WING_ANTI_ICE, 1);
+                sendJetbridgeProgram(&program);
+                return;
             }
-            return;
-        }
-
-        if (!simVars.connected) {
-            return;
-        }
-
-        //// For testing only - Leave commented out
-        //if (request.writeData.eventId == KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE) {
-        //    request.writeData.eventId = KEY_FLAPS_INCR;
-        //    request.writeData.value = 0;
-        //    printf("Intercepted event - Changed to: %d = %f\n", request.writeData.eventId, request.writeData.value);
-        //    printf("Flaps: %f\n", simVars.tfFlapsIndex);
-        //    writeJetbridgeVar("K:FLAPS HANDLE INDEX, number", simVars.tfFlapsIndex + 1.0f);
-        //}
-        //else {
-        //    printf("Unintercepted event: %d (%d) = %f\n", request.writeData.eventId, KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, request.writeData.value);
-        //}
-
-        if (request.writeData.eventId >= VJOY_BUTTONS && request.writeData.eventId <= VJOY_BUTTONS_END) {
-            // Override vJoy anti ice buttons for A310
-            if (isA310) {
-                if (request.writeData.eventId == VJOY_BUTTON_13) {
-                    // Anti ice on
-                    writeJetbridgeVar(A310_ENG1_ANTI_ICE, 1);
-                    writeJetbridgeVar(A310_ENG2_ANTI_ICE, 1);
-                    writeJetbridgeVar(A310_WING_ANTI_ICE, 1);
-                    return;
-                }
-                else if (request.writeData.eventId == VJOY_BUTTON_12) {
-                    // Anti ice off
-                    writeJetbridgeVar(A310_ENG1_ANTI_ICE, 0);
-                    writeJetbridgeVar(A310_ENG2_ANTI_ICE, 0);
-                    writeJetbridgeVar(A310_WING_ANTI_ICE, 0);
-                    return;
-                }
+            else if (writeData->eventId == VJOY_BUTTON_12) {
+                // Anti ice off
+                RpnProgram program = {};
+                writeJetbridgeVar(&program, A310_ENG1_ANTI_ICE, 0);
+                writeJetbridgeVar(&program, A310_ENG2_ANTI_ICE, 0);
+                writeJetbridgeVar(&program, A310_WING_ANTI_ICE, 0);
+                sendJetbridgeProgram(&program);
+                return;
             }
+        }
 
 #ifdef vJoyFallback
-            vJoyButtonPress(request.writeData.eventId);
+        vJoyButtonPress(writeData->eventId);
 #else
-            printf("vJoy button event ignored - vJoyFallback is not enabled\n");
+        printf("vJoy button event ignored - vJoyFallback is not enabled\n");
 #endif
-            return;
-        }
+        return;
+    }
 
 #ifdef jetbridgeFallback
-        if (isA310 && jetbridgeA310ButtonPress(request.writeData.eventId, request.writeData.value)) {
-            return;
-        }
-        else if (isFbw && jetbridgeFbwButtonPress(request.writeData.eventId, request.writeData.value)) {
-            return;
-        }
-        else if (isK100 && jetbridgeK100ButtonPress(request.writeData.eventId, request.writeData.value)) {
-            return;
-        }
-        else if (isPA28 && jetbridgePA28ButtonPress(request.writeData.eventId, request.writeData.value)) {
-            return;
-        }
-        else if (jetbridgeMiscButtonPress(request.writeData.eventId, request.writeData.value)) {
-            return;
-        }
+    if (isA310 && jetbridgeA310ButtonPress(writeData->eventId, writeData->value)) {
+        return;
+    }
+    else if (isFbw && jetbridgeFbwButtonPress(writeData->eventId, writeData->value)) {
+        return;
+    }
+    else if (isK100 && jetbridgeK100ButtonPress(writeData->eventId, writeData->value)) {
+        return;
+    }
+    else if (isPA28 && jetbridgePA28ButtonPress(writeData->eventId, writeData->value)) {
+        return;
+    }
+    else if (jetbridgeMiscButtonPress(writeData->eventId, writeData->value)) {
+        return;
+    }
 #endif
 
-        // Process custom events
-        if (request.writeData.eventId == KEY_CHECK_EVENT) {
-            int eventNum = (int)(request.writeData.value);
-            // Ignore event 1 in GA aircraft (button used for Engine Primer instead)
-            if (eventNum == 1 && !isAirliner) {
-                return;
+    // Process custom events
+    if (writeData->eventId == KEY_CHECK_EVENT) {
+        int eventNum = (int)(writeData->value);
+        // Ignore event 1 in GA aircraft (button used for Engine Primer instead)
+        if (eventNum == 1 && !isAirliner) {
+            return;
+        }
+        else if (isA310 && a310Vars.engineIgnition < 2) {
+            // If engine ignition is on then event keys start engines instead
+            if (eventNum == 1) {
+                writeJetbridgeVar(A310_ENG1_STARTER, 1);
             }
-            else if (isA310 && a310Vars.engineIgnition < 2) {
-                // If engine ignition is on then event keys start engines instead
-                if (eventNum == 1) {
-                    writeJetbridgeVar(A310_ENG1_STARTER, 1);
-                }
-                else {
-                    writeJetbridgeVar(A310_ENG2_STARTER, 1);
-                }
-                return;
+            else {
+                writeJetbridgeVar(A310_ENG2_STARTER, 1);
             }
-            EVENT_ID event = getCustomEvent(eventNum);
-            sendto(sockfd, (char*)&event, sizeof(int), 0, (SOCKADDR*)&senderAddr, addrSize);
-            if (event == EVENT_PUSHBACK_START || event == EVENT_PUSHBACK_STOP) {
-                // Don't return (need to trigger the pushback)
-                request.writeData.eventId = KEY_TOGGLE_PUSHBACK;
-                if (event == EVENT_PUSHBACK_START) {
-                    initiatedPushback = true;
-                    fixedPushback = -1;
-                }
-                else {
-                    fixedPushback = 0;
-                }
+            return;
+        }
+        EVENT_ID event = getCustomEvent(eventNum);
+        sendto(sockfd, (char*)&event, sizeof(int), 0, (SOCKADDR*)&command->addr, addrSize);
+        if (event == EVENT_PUSHBACK_START || event == EVENT_PUSHBACK_STOP) {
+            // Don't return (need to trigger the pushback)
+            writeData->eventId = KEY_TOGGLE_PUSHBACK;
+            if (event == EVENT_PUSHBACK_START) {
+                initiatedPushback = true;
+                fixedPushback = -1;
             }
             else {
-                return;
+                fixedPushback = 0;
             }
         }
-        else if (request.writeData.eventId == KEY_SKYTRACK_STATE) {
-            skytrackState = request.writeData.value;
+        else {
             return;
         }
+    }
+    else if (writeData->eventId == KEY_SKYTRACK_STATE) {
+        skytrackState = writeData->value;
+        return;
+    }
 
-        if (request.writeData.eventId == EVENT_RESET_DRONE_FOV) {
-            writeJetbridgeVar(DRONE_CAMERA_FOV, 50);
-            return;
-        }
+    if (writeData->eventId == EVENT_RESET_DRONE_FOV) {
+        writeJetbridgeVar(DRONE_CAMERA_FOV, 50);
+        return;
+    }
 
-        if (request.writeData.eventId == KEY_TOGGLE_RAMPTRUCK) {
-            printf("Ramp truck requested\n");
-        }
+    if (writeData->eventId == KEY_TOGGLE_RAMPTRUCK) {
+        printf("Ramp truck requested\n");
+    }
+
+    //if (SimConnect_TransmitClientEvent(hSimConnect, 0, writeData->eventId, (DWORD)writeData->value, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY) != 0) {
+    //    printf("Failed to transmit event: %d\n", writeData->eventId);
+    //}
+    writeJetbridgeVar(writeData->eventId, writeData->value);
+}
+
+/// <summary>
+/// Carry out all the writes the server has queued.
+/// </summary>
+void processWrites()
+{
+    WriteCommand command;
+    while (takeWrite(&command)) {
+        processWrite(&command);
+        writeDone(&command);
+    }
 
-        //if (SimConnect_TransmitClientEvent(hSimConnect, 0, request.writeData.eventId, (DWORD)request.writeData.value, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY) != 0) {
-        //    printf("Failed to transmit event: %d\n", request.writeData.eventId);
-        //}
-        writeJetbridgeVar(request.writeData.eventId, request.writeData.value);
+#ifdef SHOW_WRITE_LATENCY
+    static ULONGLONG lastShown = 0;
+    ULONGLONG now = GetTickCount64();
+    if (now - lastShown > 2000 && writeQueueStats.done > 0) {
+        printf("Write latency: Avg = %.0f us, Max = %.0f us (%ld writes, %ld dropped)\n",
+            writeQueueStats.totalMicros / writeQueueStats.done, writeQueueStats.maxMicros,
+            writeQueueStats.done, (long)writeQueueStats.dropped);
+        lastShown = now;
+    }
+#endif
+}
+
+void processRequest(int bytes)
+{
+    //// For testing only - Leave commented out
+    //if (request.requestedSize == writeDataSize) {
+    //    printf("Received %d bytes from %s - Write Request event: %s\n", bytes, inet_ntoa(senderAddr.sin_addr), WriteEvents[request.writeData.eventId].name);
+    //}
+    //else {
+    //    // To  test you can send from client with this command: echo - e '\x1\x0\x0\x0' | ncat -u 192.168.1.80 52020
+    //    printf("Received %d bytes from %s - Requesting %d bytes\n", bytes, inet_ntoa(senderAddr.sin_addr), request.requestedSize);
+    //}
+
+    if (request.requestedSize == writeDataSize) {
+        // This is a write. Leave it for the thread that owns SimConnect.
+        queueWrite(&request.writeData, &senderAddr);
     }
     else if (request.requestedSize == instrumentsDataSize) {
         // Send instrument data to the client that polled us
-        if (active != 1 || request.wantFullData || !UseDeltas) {
-            if (active != 1) {
-                printf("Instrument panel connected from %s\n", inet_ntoa(senderAddr.sin_addr));
-                active = 1;
-            }
-            sendFull(prevInstrumentsData, instrumentsDataSize);
-        }
-        else {
-            sendDelta(prevInstrumentsData, instrumentsDataSize);
-        }
+        sendData(INSTRUMENT_PANEL, instrumentsDataSize);
     }
     else if (request.requestedSize == autopilotDataSize) {
         // Send autopilot data to the client that polled us
-        if (!autopilotPanelConnected || request.wantFullData || !UseDeltas) {
-            if (!autopilotPanelConnected) {
-                printf("Autopilot panel connected from %s\n", inet_ntoa(senderAddr.sin_addr));
-                autopilotPanelConnected = true;
-            }
-            sendFull(prevAutopilotData, autopilotDataSize);
-        }
-        else {
-            sendDelta(prevAutopilotData, autopilotDataSize);
-        }
+        sendData(AUTOPILOT_PANEL, autopilotDataSize);
     }
     else if (request.requestedSize == radioDataSize) {
         // Send radio data to the client that polled us
-        if (!radioPanelConnected || request.wantFullData || !UseDeltas) {
-            if (!radioPanelConnected) {
-                printf("Radio panel connected from %s\n", inet_ntoa(senderAddr.sin_addr));
-                radioPanelConnected = true;
-            }
-            sendFull(prevRadioData, radioDataSize);
-        }
-        else {
-            sendDelta(prevRadioData, radioDataSize);
-        }
+        sendData(RADIO_PANEL, radioDataSize);
     }
     else if (request.requestedSize == lightsDataSize) {
         // Send power/lights data to the client that polled us
-        if (!lightsPanelConnected || request.wantFullData || !UseDeltas) {
-            if (!lightsPanelConnected) {
-                printf("Power/Lights panel connected from %s\n", inet_ntoa(senderAddr.sin_addr));
-                lightsPanelConnected = true;
-            }
-            sendFull(prevLightsData, lightsDataSize);
-        }
-        else {
-            sendDelta(prevLightsData, lightsDataSize);
-        }
+        sendData(LIGHTS_PANEL, lightsDataSize);
     }
     else {
         // Data size mismatch
@@ -1149,6 +1136,42 @@ void processRequest(int bytes)
     }
 }
 
+/// <summary>
+/// Process every request that is waiting on the socket.
+/// </summary>
+void receiveRequests()
+{
+    while (!quit) {
+        bytes = recvfrom(sockfd, (char*)&request, sizeof(request), 0, (SOCKADDR*)&senderAddr, &addrSize);
+        if (bytes == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) {
+            // No more requests queued
+            return;
+        }
+
+#ifdef SHOW_NETWORK_USAGE
+        networkIn += bytes;
+#endif
+        if (bytes > 3) {
+            processRequest(bytes);
+        }
+        else if (bytes == -1) {
+            int error = WSAGetLastError();
+            if (error == 10040) {
+                printf("Received more than %ld bytes from %s (WSAError = %d)\n", sizeof(request), inet_ntoa(senderAddr.sin_addr), error);
+            }
+            else {
+                printf("Received from %s but WSAError = %d\n", inet_ntoa(senderAddr.sin_addr), error);
+                if (error != 10054) {
+                    return;
+                }
+            }
+        }
+        else {
+            printf("Received %d bytes from %s - Not a valid request\n", bytes, inet_ntoa(senderAddr.sin_addr));
+        }
+    }
+}
+
 void server()
 {
     WSADATA wsaData;
@@ -1177,55 +1200,52 @@ void server()
         exit(1);
     }
 
-    deltaData = (char*)malloc(MaxDataSize);
-    prevInstrumentsData = (char*)malloc(MaxDataSize);
-    prevAutopilotData = (char*)malloc(MaxDataSize);
-    prevRadioData = (char*)malloc(MaxDataSize);
-    prevLightsData = (char*)malloc(MaxDataSize);
+    sessionsInit();
 
     printf("Server listening on port %d\n", Port);
 
-    timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 500000;
+    // Wake up when a panel sends a request or when there is a new frame to push
+    WSAEVENT netEvent = WSACreateEvent();
+    WSAEventSelect(sockfd, netEvent, FD_READ);
+    HANDLE events[2] = { netEvent, frameEvent };
+    deltasInit(&takeFrame(NULL)->vars);
 
     while (!quit) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(sockfd, &fds);
-
-        // Wait for instrument panel to poll (non-blocking, 0.5 second timeout)
-        int sel = select(FD_SETSIZE, &fds, 0, 0, &timeout);
-        if (sel > 0) {
-            bytes = recvfrom(sockfd, (char*)&request, sizeof(request), 0, (SOCKADDR*)&senderAddr, &addrSize);
-
-#ifdef SHOW_NETWORK_USAGE
-            networkIn += bytes;
-#endif
-            if (bytes > 3) {
-                processRequest(bytes);
+        // Wait for a panel to poll or a new frame (0.5 second timeout)
+        DWORD res = WaitForMultipleObjects(2, events, FALSE, 500);
+
+        // Only diff each frame once, however many panels are connected
+        bool isNewFrame = isFrameWaiting();
+        LONGLONG sendStart = 0;
+        if (isNewFrame) {
+            sendStart = stageStart();
+            if (UseTaggedData) {
+                unsigned long long dirty[VarMaskSize];
+                PublishedFrame* published = takeFrame(dirty);
+                stageDone(STAGE_HANDOFF, published->publishedTime);
+                snapshotDirtyFrame(&published->vars, dirty);
             }
             else {
-                if (bytes == -1) {
-                    int error = WSAGetLastError();
-                    if (error == 10040) {
-                        printf("Received more than %ld bytes from %s (WSAError = %d)\n", sizeof(request), inet_ntoa(senderAddr.sin_addr), error);
-                    }
-                    else {
-                        printf("Received from %s but WSAError = %d\n", inet_ntoa(senderAddr.sin_addr), error);
-                    }
-                }
-                else {
-                    printf("Received %d bytes from %s - Not a valid request\n", bytes, inet_ntoa(senderAddr.sin_addr));
-                }
-                bytes = SOCKET_ERROR;
+                PublishedFrame* published = takeFrame(NULL);
+                stageDone(STAGE_HANDOFF, published->publishedTime);
+                snapshotFrame(&published->vars);
             }
         }
-        else {
-            bytes = SOCKET_ERROR;
+
+        if (res == WAIT_OBJECT_0) {
+            WSAResetEvent(netEvent);
+            receiveRequests();
         }
 
-        if (bytes == SOCKET_ERROR && active != 0) {
+        if (isNewFrame) {
+            pushSubscriptions();
+            stageDone(STAGE_SEND, sendStart);
+        }
+
+        if (expireSessions() > 0) {
+            active = 1;
+        }
+        else if (active != 0) {
             printf("Waiting for instrument panel to connect\n");
             active = 0;
         }
@@ -1246,12 +1266,7 @@ void server()
 #endif
     }
 
-    free(deltaData);
-    free(prevInstrumentsData);
-    free(prevAutopilotData);
-    free(prevRadioData);
-    free(prevLightsData);
-
+    WSACloseEvent(netEvent);
     closesocket(sockfd);
     printf("Server stopped\n");
 }
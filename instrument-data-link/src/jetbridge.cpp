@@ -2,11 +2,12 @@
 
 #ifdef jetbridgeFallback
 
-#include "..\jetbridge\Client.h"
+#include "../jetbridge/Client.h"
 #include "LVars-A310.h"
 #include "LVars-Fbw.h"
 #include "LVars-Kodiak100.h"
 #include "LVars-PA28.h"
+#include "sessions.h"
 
 //#define DEBUG_WRITES
 
@@ -17,311 +18,783 @@ extern WriteEvent WriteEvents[];
 
 jetbridge::Client* jetbridgeClient = 0;
 
+char eventSuffix[SIM_STOP][jetbridge::kPacketDataSize];
+int eventSuffixLen[SIM_STOP];
 
-void jetbridgeInit(HANDLE hSimConnect)
+
+// Lvars that are polled are packed into as few uplink packets as
+// possible. Jetbridge replies to a packet with the RPN code followed by
+// the single value it evaluated to, so several vars that can only hold
+// small non-negative integers (switches, modes, bools) are combined into
+// one value, i.e. (A) (B) rangeA * + (C) rangeA*rangeB * + etc. A range
+// of 0 means the var can hold any value and needs a packet of its own.
+// Only give a var a range if it can never go outside it, otherwise it
+// would corrupt the other vars in the same packet.
+const int MaxBatchPackets = 64;
+const int MaxPackedValue = 1 << 20;
+
+// Replies are looked up by a hash of their RPN code (must be a power of 2)
+const int BatchHashSize = 128;
+
+// Leave room in the reply for the value that gets appended to the code
+const int MaxPacketCode = jetbridge::kPacketDataSize - 16;
+
+// Each packet is polled at the rate of its class. The interval backs
+// off towards the maximum while the value doesn't change and drops
+// back to the base rate as soon as it does or a panel writes to it.
+enum LVAR_RATE {
+    LVAR_FAST,
+    LVAR_NORMAL,
+    LVAR_SLOW
+};
+
+struct LVarRate {
+    int baseMillis;
+    int maxMillis;
+};
+
+const LVarRate LVarRates[] = {
+    { 50, 200 },    // LVAR_FAST (pedals, FCU dials)
+    { 100, 800 },   // LVAR_NORMAL (autopilot modes)
+    { 500, 2000 }   // LVAR_SLOW (overhead switches)
+};
+
+// A read either stores its value straight into a target var or calls
+// a handler if the value needs more work. simVar is the var in SimVars
+// the lvar ends up in (directly or via the aircraft mapping) so it is
+// only read while a panel that wants that var is connected. NULL means
+// it is always needed.
+struct JetbridgeRead {
+    const char* var;
+    int range;
+    LVAR_RATE rate;
+    double* simVar;
+    double* target;
+    void (*handler)(double value);
+};
+
+struct JetbridgePacket {
+    char rpnCode[jetbridge::kPacketDataSize];
+    int codeLen;
+    unsigned int hash;
+    const JetbridgeRead* reads;
+    int count;
+    std::atomic<bool> inFlight;
+    LVAR_RATE rate;
+    std::atomic<int> intervalMillis;
+    std::atomic<bool> boost;
+    int panelMask;
+    ULONGLONG nextPoll;
+    double lastValue;
+    unsigned int clampLogged;   // Packed reads already reported as clamped
+};
+
+struct JetbridgeBatch {
+    const JetbridgeRead* reads;
+    int packetCount;
+    JetbridgePacket packets[MaxBatchPackets];
+    short hashSlots[BatchHashSize];
+};
+
+static void a310BeaconLights(double value)
 {
-    if (jetbridgeClient != 0) {
-        delete jetbridgeClient;
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.beaconLights) {
+        writeJetbridgeVar(A310_BEACON_LIGHTS, a310Vars.beaconLights);
     }
-
-    jetbridgeClient = new jetbridge::Client(hSimConnect);
 }
 
-void readJetbridgeVar(const char* var)
+static void a310LandingLights(double value)
 {
-    char rpnCode[128];
-    sprintf_s(rpnCode, "(%s)", var);
-    jetbridgeClient->request(rpnCode);
-    //printf("%s\n", rpnCode);
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.landingLights) {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_LANDING_LIGHTS_L, a310Vars.landingLights);
+        writeJetbridgeVar(&program, A310_LANDING_LIGHTS_R, a310Vars.landingLights);
+        sendJetbridgeProgram(&program);
+    }
 }
 
-void writeJetbridgeVar(const char* var, double val)
+static void a310TaxiLights(double value)
 {
-    // FS2020 uses RPN (Reverse Polish Notation).
-    char rpnCode[128];
-    sprintf_s(rpnCode, "%f (>%s)", val, var);
-    jetbridgeClient->request(rpnCode);
-#ifdef DEBUG_WRITES
-    printf("%s\n", rpnCode);
-#endif
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.taxiLights) {
+        writeJetbridgeVar(A310_TAXI_LIGHTS, a310Vars.taxiLights);
+    }
 }
 
-void writeJetbridgeVar(EVENT_ID eventId, double val)
+static void a310TurnoffLights(double value)
 {
-    char rpnCode[128];
-    sprintf_s(rpnCode, "%f (>K:%s)", val, WriteEvents[eventId].name);
-    jetbridgeClient->request(rpnCode);
-#ifdef DEBUG_WRITES
-    printf("%s\n", rpnCode);
-#endif
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.turnoffLights) {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_TURNOFF_LIGHTS_L, a310Vars.turnoffLights);
+        writeJetbridgeVar(&program, A310_TURNOFF_LIGHTS_R, a310Vars.turnoffLights);
+        sendJetbridgeProgram(&program);
+    }
 }
 
-void writeJetbridgeHvar(const char* var)
+static void a310NavLights(double value)
 {
-    char rpnCode[128];
-    sprintf_s(rpnCode, "(>H:%s)", var);
-    jetbridgeClient->request(rpnCode);
-#ifdef DEBUG_WRITES
-    printf("%s\n", rpnCode);
-#endif
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.navLights) {
+        writeJetbridgeVar(A310_NAV_LIGHTS, a310Vars.navLights);
+    }
 }
 
-void writeJetbridge_Fbw_CabinLights(double val)
+static void a310Strobes(double value)
 {
-    const char* rpnPotentiometer = "%f %d (>K:2:LIGHT_POTENTIOMETER_SET)";
-    const int OVERHEAD_INTEG_LIGHT = 86;
-    const int GLARESHIELD_INTEG_LIGHT = 84;
-    const int GLARESHIELD_LCD_LIGHT = 87;
-    const int FLOOD_LIGHT_CPT = 83;
-    const int FLOOD_LIGHT_FO = 76;
-    const int INTEG_LIGHT = 85;
+    // Force to required value (doesn't always stick)
+    if (value != a310Vars.strobes) {
+        writeJetbridgeVar(A310_STROBES, a310Vars.strobes);
+    }
+}
 
-    char rpnCode[128];
+static void a310HeadingMode(double value)
+{
+    simVars.jbManagedHeading = 1 - value;
+}
 
-    sprintf(rpnCode, rpnPotentiometer, val, OVERHEAD_INTEG_LIGHT);
-    jetbridgeClient->request(rpnCode);
-    sprintf(rpnCode, rpnPotentiometer, val, GLARESHIELD_INTEG_LIGHT);
-    jetbridgeClient->request(rpnCode);
-    sprintf(rpnCode, rpnPotentiometer, val, GLARESHIELD_LCD_LIGHT);
-    jetbridgeClient->request(rpnCode);
-    sprintf(rpnCode, rpnPotentiometer, val, FLOOD_LIGHT_CPT);
-    jetbridgeClient->request(rpnCode);
-    sprintf(rpnCode, rpnPotentiometer, val, FLOOD_LIGHT_FO);
-    jetbridgeClient->request(rpnCode);
-    sprintf(rpnCode, rpnPotentiometer, val, INTEG_LIGHT);
-    jetbridgeClient->request(rpnCode);
+static void a310PitchMode(double value)
+{
+    // 7 & 8 = ALL OFF, 6 & 9 = Alt Hold, 2 & 4 = LVL/CH, 3 & 5 & 15 & 20 & 26 = PROFILE
+    a310Vars.pitchMode = value;
+    a310Vars.altHold = (a310Vars.pitchMode == 6 || a310Vars.pitchMode == 9);
+    a310Vars.levelChange = (a310Vars.pitchMode == 2 || a310Vars.pitchMode == 4);
+    a310Vars.profile = (!a310Vars.altHold && !a310Vars.levelChange && a310Vars.pitchMode != 7 && a310Vars.pitchMode != 8);
 }
 
-void updateA310FromJetbridge(const char* data)
+// Vars with a range are listed first, grouped by rate, so they can be
+// packed together
+const JetbridgeRead A310Reads[] = {
+    { A310_APU_MASTER_SW, 2, LVAR_SLOW, &simVars.apuMasterSw, &simVars.apuMasterSw },
+    { A310_APU_START, 2, LVAR_SLOW, &simVars.apuStartSwitch, &a310Vars.apuStart },
+    { A310_APU_START_AVAIL, 2, LVAR_SLOW, &simVars.apuPercentRpm, &a310Vars.apuStartAvail },
+    { A310_APU_BLEED, 2, LVAR_SLOW, &simVars.apuBleed, &simVars.apuBleed },
+    { A310_ELEC_BAT1, 2, LVAR_SLOW, &simVars.elecBat1, &simVars.elecBat1 },
+    { A310_ELEC_BAT2, 2, LVAR_SLOW, &simVars.elecBat2, &simVars.elecBat2 },
+    { A310_SEATBELTS_SWITCH, 2, LVAR_SLOW, &simVars.seatBeltsSwitch, &a310Vars.seatbeltsSwitch },
+    { A310_BEACON_LIGHTS, 4, LVAR_SLOW, &simVars.lightStates, NULL, a310BeaconLights },
+    { A310_LANDING_LIGHTS_L, 4, LVAR_SLOW, &simVars.lightStates, NULL, a310LandingLights },
+    { A310_TAXI_LIGHTS, 4, LVAR_SLOW, &simVars.lightStates, NULL, a310TaxiLights },
+    { A310_TURNOFF_LIGHTS_L, 4, LVAR_SLOW, &simVars.lightStates, NULL, a310TurnoffLights },
+    { A310_NAV_LIGHTS, 4, LVAR_SLOW, &simVars.lightStates, NULL, a310NavLights },
+    { A310_TCAS_MODE, 8, LVAR_NORMAL, &simVars.jbTcasMode, &simVars.jbTcasMode },
+    { A310_AP_IS_MACH, 2, LVAR_NORMAL, &simVars.jbShowMach, &simVars.jbShowMach },
+    { A310_AUTOBRAKE, 8, LVAR_NORMAL, &simVars.jbAutobrake, &simVars.jbAutobrake },
+    { A310_FLIGHTDIRECTOR, 2, LVAR_NORMAL, &simVars.flightDirectorActive, &a310Vars.flightDirector },
+    { A310_AUTOPILOT, 2, LVAR_NORMAL, &simVars.autopilotEngaged, &a310Vars.autopilot },
+    { A310_AUTOTHROTTLE, 2, LVAR_NORMAL, &simVars.autothrottleActive, &a310Vars.autothrottle },
+    { A310_LOCALISER, 2, LVAR_NORMAL, &simVars.autopilotApproachHold, &a310Vars.localiser },
+    { A310_APPROACH, 2, LVAR_NORMAL, &simVars.autopilotGlideslopeHold, &a310Vars.approach },
+    { A310_ENG_IGNITION, 4, LVAR_NORMAL, NULL, &a310Vars.engineIgnition },
+    { A310_HEADING_MODE, 2, LVAR_NORMAL, &simVars.jbManagedHeading, NULL, a310HeadingMode },
+    { A310_PITCH_MODE, 32, LVAR_NORMAL, &simVars.jbManagedSpeed, NULL, a310PitchMode },
+    { A310_GEAR_HANDLE, 4, LVAR_NORMAL, NULL, &a310Vars.gearHandle },
+    { A310_STROBES, 0, LVAR_SLOW, &simVars.lightStates, NULL, a310Strobes },
+    { A310_PITCH_TRIM1, 0, LVAR_NORMAL, &simVars.jbPitchTrim, &a310Vars.pitchTrim1 },
+    { A310_PITCH_TRIM2, 0, LVAR_NORMAL, &simVars.jbPitchTrim, &a310Vars.pitchTrim2 },
+    { A310_AP_AIRSPEED, 0, LVAR_FAST, &simVars.autopilotAirspeed, &a310Vars.autopilotAirspeed },
+    { A310_AP_HEADING, 0, LVAR_FAST, &simVars.autopilotHeading, &a310Vars.autopilotHeading },
+    { A310_AP_ALTITUDE, 0, LVAR_FAST, &simVars.autopilotAltitude, &a310Vars.autopilotAltitude },
+    { A310_AP_VERTICALSPEED, 0, LVAR_FAST, &simVars.autopilotVerticalSpeed, &a310Vars.autopilotVerticalSpeed },
+    { A310_ILS_FREQUENCY, 0, LVAR_NORMAL, &simVars.nav1Freq, &a310Vars.ilsFrequency },
+    { A310_ILS_COURSE, 0, LVAR_NORMAL, &simVars.vor1Obs, &a310Vars.ilsCourse },
+    { NULL, 0, LVAR_NORMAL, NULL, NULL }
+};
+
+const JetbridgeRead FbwReads[] = {
+    { A32NX_APU_MASTER_SW, 2, LVAR_SLOW, &simVars.apuMasterSw, &simVars.apuMasterSw },
+    { A32NX_APU_START, 2, LVAR_SLOW, &simVars.apuStartSwitch, &fbwVars.apuStart },
+    { A32NX_APU_START_AVAIL, 2, LVAR_SLOW, &simVars.apuPercentRpm, &fbwVars.apuStartAvail },
+    { A32NX_APU_BLEED, 2, LVAR_SLOW, &simVars.apuBleed, &simVars.apuBleed },
+    { A32NX_ELEC_BAT1, 2, LVAR_SLOW, &simVars.elecBat1, &simVars.elecBat1 },
+    { A32NX_ELEC_BAT2, 2, LVAR_SLOW, &simVars.elecBat2, &simVars.elecBat2 },
+    { A32NX_XPNDR_MODE, 4, LVAR_SLOW, &simVars.transponderState, &fbwVars.xpndrMode },
+    { A32NX_FLAPS_INDEX, 8, LVAR_NORMAL, &simVars.tfFlapsIndex, &fbwVars.flapsIndex },
+    { A32NX_PARK_BRAKE_POS, 2, LVAR_NORMAL, &simVars.parkingBrakeOn, &fbwVars.parkBrakePos },
+    { A32NX_AUTOPILOT_1, 2, LVAR_NORMAL, &simVars.autopilotEngaged, &fbwVars.autopilot1 },
+    { A32NX_AUTOPILOT_2, 2, LVAR_NORMAL, &simVars.autopilotEngaged, &fbwVars.autopilot2 },
+    { A32NX_AUTOTHRUST, 4, LVAR_NORMAL, &simVars.autothrottleActive, &fbwVars.autothrust },
+    { A32NX_TCAS_MODE, 4, LVAR_NORMAL, &simVars.jbTcasMode, &simVars.jbTcasMode },
+    { A32NX_MANAGED_SPEED, 2, LVAR_NORMAL, &simVars.jbManagedSpeed, &simVars.jbManagedSpeed },
+    { A32NX_MANAGED_HEADING, 2, LVAR_NORMAL, &simVars.jbManagedHeading, &simVars.jbManagedHeading },
+    { A32NX_MANAGED_ALTITUDE, 2, LVAR_NORMAL, &simVars.jbManagedAltitude, &simVars.jbManagedAltitude },
+    { A32NX_LATERAL_MODE, 64, LVAR_NORMAL, &simVars.jbLateralMode, &simVars.jbLateralMode },
+    { A32NX_VERTICAL_MODE, 64, LVAR_NORMAL, &simVars.jbVerticalMode, &simVars.jbVerticalMode },
+    { A32NX_LOC_MODE, 2, LVAR_NORMAL, &simVars.jbLocMode, &simVars.jbLocMode },
+    { A32NX_APPR_MODE, 2, LVAR_NORMAL, &simVars.jbApprMode, &simVars.jbApprMode },
+    { A32NX_AUTOTHRUST_MODE, 16, LVAR_NORMAL, &simVars.jbAutothrustMode, &simVars.jbAutothrustMode },
+    { A32NX_AUTOBRAKE, 8, LVAR_NORMAL, &simVars.jbAutobrake, &simVars.jbAutobrake },
+    { A32NX_SPOILERS_HANDLE_POS, 0, LVAR_NORMAL, &simVars.tfSpoilersPosition, &fbwVars.spoilersHandlePos },
+    { A32NX_LEFT_BRAKEPEDAL, 0, LVAR_FAST, &simVars.brakeLeftPedal, &fbwVars.leftBrakePedal },
+    { A32NX_RIGHT_BRAKEPEDAL, 0, LVAR_FAST, &simVars.brakeRightPedal, &fbwVars.rightBrakePedal },
+    { A32NX_RUDDER_PEDAL_POS, 0, LVAR_FAST, &simVars.rudderPosition, &fbwVars.rudderPedalPos },
+    { A32NX_AUTOPILOT_HDG, 0, LVAR_FAST, &simVars.autopilotHeading, &fbwVars.autopilotHeading },
+    { A32NX_AUTOPILOT_VS, 0, LVAR_FAST, &simVars.autopilotVerticalSpeed, &fbwVars.autopilotVerticalSpeed },
+    { A32NX_AUTOPILOT_FPA, 0, LVAR_FAST, &simVars.autopilotVerticalSpeed, &fbwVars.autopilotFpa },
+    { A32NX_ENGINE_EGT1, 0, LVAR_NORMAL, &simVars.exhaustGasTemp1, &fbwVars.engineEgt1 },
+    { A32NX_ENGINE_EGT2, 0, LVAR_NORMAL, &simVars.exhaustGasTemp2, &fbwVars.engineEgt2 },
+    { A32NX_ENGINE_FUEL_FLOW1, 0, LVAR_NORMAL, &simVars.engineFuelFlow1, &fbwVars.engineFuelFlow1 },
+    { A32NX_ENGINE_FUEL_FLOW2, 0, LVAR_NORMAL, &simVars.engineFuelFlow2, &fbwVars.engineFuelFlow2 },
+    { NULL, 0, LVAR_NORMAL, NULL, NULL }
+};
+
+JetbridgeBatch a310Batch;
+JetbridgeBatch fbwBatch;
+
+/// <summary>
+/// Appends a read to packed RPN code. Units that make no difference
+/// to an lvar are dropped to fit more reads into the packet. The value
+/// is rounded and clamped to its range by the sim so a bad value can
+/// only spoil itself and not the other values in the packet.
+/// </summary>
+static int appendPackedRead(char* rpnCode, int codeLen, const char* var, int range, int multiplier)
 {
-    if (strncmp(&data[1], A310_APU_MASTER_SW, sizeof(A310_APU_MASTER_SW) - 1) == 0) {
-        simVars.apuMasterSw = atof(&data[sizeof(A310_APU_MASTER_SW) + 1]);
-    }
-    else if (strncmp(&data[1], A310_APU_START, sizeof(A310_APU_START) - 1) == 0) {
-        a310Vars.apuStart = atof(&data[sizeof(A310_APU_START) + 1]);
-    }
-    else if (strncmp(&data[1], A310_APU_START_AVAIL, sizeof(A310_APU_START_AVAIL) - 1) == 0) {
-        a310Vars.apuStartAvail = atof(&data[sizeof(A310_APU_START_AVAIL) + 1]);
+    char name[jetbridge::kPacketDataSize];
+    sprintf_s(name, "%s", var);
+
+    char* units = strrchr(name, ',');
+    if (units && (_stricmp(units, ", bool") == 0 || _stricmp(units, ", number") == 0 || _stricmp(units, ", enum") == 0)) {
+        *units = '\0';
     }
-    else if (strncmp(&data[1], A310_APU_BLEED, sizeof(A310_APU_BLEED) - 1) == 0) {
-        simVars.apuBleed = atof(&data[sizeof(A310_APU_BLEED) + 1]);
+
+    char term[jetbridge::kPacketDataSize];
+    if (multiplier == 1) {
+        sprintf_s(term, "(%s) near 0 max %d min", name, range - 1);
     }
-    else if (strncmp(&data[1], A310_ELEC_BAT1, sizeof(A310_ELEC_BAT1) - 1) == 0) {
-        simVars.elecBat1 = atof(&data[sizeof(A310_ELEC_BAT1) + 1]);
+    else {
+        sprintf_s(term, " (%s) near 0 max %d min %d * +", name, range - 1, multiplier);
     }
-    else if (strncmp(&data[1], A310_ELEC_BAT2, sizeof(A310_ELEC_BAT2) - 1) == 0) {
-        simVars.elecBat2 = atof(&data[sizeof(A310_ELEC_BAT2) + 1]);
+
+    int termLen = strlen(term);
+    if (codeLen + termLen > MaxPacketCode) {
+        return -1;
     }
-    else if (strncmp(&data[1], A310_SEATBELTS_SWITCH, sizeof(A310_SEATBELTS_SWITCH) - 1) == 0) {
-        a310Vars.seatbeltsSwitch = atof(&data[sizeof(A310_SEATBELTS_SWITCH) + 1]);
+
+    memcpy(&rpnCode[codeLen], term, termLen + 1);
+    return codeLen + termLen;
+}
+
+/// <summary>
+/// FNV-1a hash of a packet's RPN code.
+/// </summary>
+static unsigned int hashCode(const char* rpnCode, int codeLen)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < codeLen; i++) {
+        hash = (hash ^ (unsigned char)rpnCode[i]) * 16777619u;
     }
-    else if (strncmp(&data[1], A310_BEACON_LIGHTS, sizeof(A310_BEACON_LIGHTS) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_BEACON_LIGHTS) + 1]) != a310Vars.beaconLights) {
-            writeJetbridgeVar(A310_BEACON_LIGHTS, a310Vars.beaconLights);
-        }
+    return hash;
+}
+
+/// <summary>
+/// Parses the value Jetbridge appends to a reply. Handles the plain
+/// fixed point values it sends without the overhead of atof and falls
+/// back to atof for anything else.
+/// </summary>
+double parseJetbridgeValue(const char* str)
+{
+    const char* pos = str;
+    bool negative = (*pos == '-');
+    if (negative) {
+        pos++;
     }
-    else if (strncmp(&data[1], A310_LANDING_LIGHTS_L, sizeof(A310_LANDING_LIGHTS_L) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_LANDING_LIGHTS_L) + 1]) != a310Vars.landingLights) {
-            writeJetbridgeVar(A310_LANDING_LIGHTS_L, a310Vars.landingLights);
-            writeJetbridgeVar(A310_LANDING_LIGHTS_R, a310Vars.landingLights);
-        }
+
+    // Up to 15 digits are exact in a double so the result matches atof
+    double digits = 0;
+    double scale = 1;
+    int digitCount = 0;
+    while (*pos >= '0' && *pos <= '9') {
+        digits = digits * 10 + (*pos - '0');
+        digitCount++;
+        pos++;
     }
-    else if (strncmp(&data[1], A310_TAXI_LIGHTS, sizeof(A310_TAXI_LIGHTS) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_TAXI_LIGHTS) + 1]) != a310Vars.taxiLights) {
-            writeJetbridgeVar(A310_TAXI_LIGHTS, a310Vars.taxiLights);
+
+    if (*pos == '.') {
+        pos++;
+        while (*pos >= '0' && *pos <= '9') {
+            digits = digits * 10 + (*pos - '0');
+            scale *= 10;
+            digitCount++;
+            pos++;
         }
     }
-    else if (strncmp(&data[1], A310_TURNOFF_LIGHTS_L, sizeof(A310_TURNOFF_LIGHTS_L) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_TURNOFF_LIGHTS_L) + 1]) != a310Vars.turnoffLights) {
-            writeJetbridgeVar(A310_TURNOFF_LIGHTS_L, a310Vars.turnoffLights);
-            writeJetbridgeVar(A310_TURNOFF_LIGHTS_R, a310Vars.turnoffLights);
-        }
+
+    if (*pos != '\0' || digitCount == 0 || digitCount > 15) {
+        return atof(str);
     }
-    else if (strncmp(&data[1], A310_NAV_LIGHTS, sizeof(A310_NAV_LIGHTS) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_NAV_LIGHTS) + 1]) != a310Vars.navLights) {
-            writeJetbridgeVar(A310_NAV_LIGHTS, a310Vars.navLights);
-        }
+
+    return negative ? -digits / scale : digits / scale;
+}
+
+/// <summary>
+/// Works out which panels need a read from where its SimVars var is.
+/// </summary>
+static int readPanelMask(const JetbridgeRead* read)
+{
+    int panelMask = 0;
+    long offset = 0;
+    if (read->simVar) {
+        offset = (long)((char*)read->simVar - (char*)&simVars);
     }
-    else if (strncmp(&data[1], A310_STROBES, sizeof(A310_STROBES) - 1) == 0) {
-        // Force to required value (doesn't always stick)
-        if (atof(&data[sizeof(A310_STROBES) + 1]) != a310Vars.strobes) {
-            writeJetbridgeVar(A310_STROBES, a310Vars.strobes);
+
+    for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+        if (offset < panelDataSize((PANEL_TYPE)panel)) {
+            panelMask |= 1 << panel;
         }
     }
-    else if (strncmp(&data[1], A310_PITCH_TRIM1, sizeof(A310_PITCH_TRIM1) - 1) == 0) {
-        a310Vars.pitchTrim1 = atof(&data[sizeof(A310_PITCH_TRIM1) + 1]);
-    }
-    else if (strncmp(&data[1], A310_PITCH_TRIM2, sizeof(A310_PITCH_TRIM2) - 1) == 0) {
-        a310Vars.pitchTrim2 = atof(&data[sizeof(A310_PITCH_TRIM2) + 1]);
-    }
-    else if (strncmp(&data[1], A310_TCAS_MODE, sizeof(A310_TCAS_MODE) - 1) == 0) {
-        simVars.jbTcasMode = atof(&data[sizeof(A310_TCAS_MODE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AP_AIRSPEED, sizeof(A310_AP_AIRSPEED) - 1) == 0) {
-        a310Vars.autopilotAirspeed = atof(&data[sizeof(A310_AP_AIRSPEED) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AP_IS_MACH, sizeof(A310_AP_IS_MACH) - 1) == 0) {
-        simVars.jbShowMach = atof(&data[sizeof(A310_AP_IS_MACH) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AP_HEADING, sizeof(A310_AP_HEADING) - 1) == 0) {
-        a310Vars.autopilotHeading = atof(&data[sizeof(A310_AP_HEADING) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AP_ALTITUDE, sizeof(A310_AP_ALTITUDE) - 1) == 0) {
-        a310Vars.autopilotAltitude = atof(&data[sizeof(A310_AP_ALTITUDE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AP_VERTICALSPEED, sizeof(A310_AP_VERTICALSPEED) - 1) == 0) {
-        a310Vars.autopilotVerticalSpeed = atof(&data[sizeof(A310_AP_VERTICALSPEED) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AUTOBRAKE, sizeof(A310_AUTOBRAKE) - 1) == 0) {
-        simVars.jbAutobrake = atof(&data[sizeof(A310_AUTOBRAKE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_FLIGHTDIRECTOR, sizeof(A310_FLIGHTDIRECTOR) - 1) == 0) {
-        a310Vars.flightDirector = atof(&data[sizeof(A310_FLIGHTDIRECTOR) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AUTOPILOT, sizeof(A310_AUTOPILOT) - 1) == 0) {
-        a310Vars.autopilot = atof(&data[sizeof(A310_AUTOPILOT) + 1]);
-    }
-    else if (strncmp(&data[1], A310_AUTOTHROTTLE, sizeof(A310_AUTOTHROTTLE) - 1) == 0) {
-        a310Vars.autothrottle = atof(&data[sizeof(A310_AUTOTHROTTLE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_LOCALISER, sizeof(A310_LOCALISER) - 1) == 0) {
-        a310Vars.localiser = atof(&data[sizeof(A310_LOCALISER) + 1]);
-    }
-    else if (strncmp(&data[1], A310_APPROACH, sizeof(A310_APPROACH) - 1) == 0) {
-        a310Vars.approach = atof(&data[sizeof(A310_APPROACH) + 1]);
-    }
-    else if (strncmp(&data[1], A310_ENG_IGNITION, sizeof(A310_ENG_IGNITION) - 1) == 0) {
-        // 1 = Start A, 3 = Off
-        a310Vars.engineIgnition = atof(&data[sizeof(A310_ENG_IGNITION) + 1]);
-    }
-    else if (strncmp(&data[1], A310_HEADING_MODE, sizeof(A310_HEADING_MODE) - 1) == 0) {
-        simVars.jbManagedHeading = 1 - atof(&data[sizeof(A310_HEADING_MODE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_PITCH_MODE, sizeof(A310_PITCH_MODE) - 1) == 0) {
-        // 7 & 8 = ALL OFF, 6 & 9 = Alt Hold, 2 & 4 = LVL/CH, 3 & 5 & 15 & 20 & 26 = PROFILE
-        a310Vars.pitchMode = atof(&data[sizeof(A310_PITCH_MODE) + 1]);
-        a310Vars.altHold = (a310Vars.pitchMode == 6 || a310Vars.pitchMode == 9);
-        a310Vars.levelChange = (a310Vars.pitchMode == 2 || a310Vars.pitchMode == 4);
-        a310Vars.profile = (!a310Vars.altHold && !a310Vars.levelChange && a310Vars.pitchMode != 7 && a310Vars.pitchMode != 8);
-    }
-    else if (strncmp(&data[1], A310_GEAR_HANDLE, sizeof(A310_GEAR_HANDLE) - 1) == 0) {
-        a310Vars.gearHandle = atof(&data[sizeof(A310_GEAR_HANDLE) + 1]);
-    }
-    else if (strncmp(&data[1], A310_ILS_FREQUENCY, sizeof(A310_ILS_FREQUENCY) - 1) == 0) {
-       a310Vars.ilsFrequency = atof(&data[sizeof(A310_ILS_FREQUENCY) + 1]);
-    }
-    else if (strncmp(&data[1], A310_ILS_COURSE, sizeof(A310_ILS_COURSE) - 1) == 0) {
-        a310Vars.ilsCourse = atof(&data[sizeof(A310_ILS_COURSE) + 1]);
-    }
+
+    return panelMask;
 }
 
-void updateFbwFromJetbridge(const char* data)
+/// <summary>
+/// Packs a list of reads into as few packets as possible.
+/// </summary>
+static void batchInit(JetbridgeBatch* batch, const JetbridgeRead* reads)
 {
-    if (strncmp(&data[1], A32NX_APU_MASTER_SW, sizeof(A32NX_APU_MASTER_SW) - 1) == 0) {
-        simVars.apuMasterSw = atof(&data[sizeof(A32NX_APU_MASTER_SW) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_APU_START, sizeof(A32NX_APU_START) - 1) == 0) {
-        fbwVars.apuStart = atof(&data[sizeof(A32NX_APU_START) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_APU_START_AVAIL, sizeof(A32NX_APU_START_AVAIL) - 1) == 0) {
-        fbwVars.apuStartAvail = atof(&data[sizeof(A32NX_APU_START_AVAIL) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_APU_BLEED, sizeof(A32NX_APU_BLEED) - 1) == 0) {
-        simVars.apuBleed = atof(&data[sizeof(A32NX_APU_BLEED) + 1]);
+    batch->reads = reads;
+    batch->packetCount = 0;
+    for (int i = 0; i < MaxBatchPackets; i++) {
+        batch->packets[i].inFlight = false;
     }
-    else if (strncmp(&data[1], A32NX_ELEC_BAT1, sizeof(A32NX_ELEC_BAT1) - 1) == 0) {
-        simVars.elecBat1 = atof(&data[sizeof(A32NX_ELEC_BAT1) + 1]);
+    for (int i = 0; i < BatchHashSize; i++) {
+        batch->hashSlots[i] = -1;
     }
-    else if (strncmp(&data[1], A32NX_ELEC_BAT2, sizeof(A32NX_ELEC_BAT2) - 1) == 0) {
-        simVars.elecBat2 = atof(&data[sizeof(A32NX_ELEC_BAT2) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_FLAPS_INDEX, sizeof(A32NX_FLAPS_INDEX) - 1) == 0) {
-        fbwVars.flapsIndex = atof(&data[sizeof(A32NX_FLAPS_INDEX) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_PARK_BRAKE_POS, sizeof(A32NX_PARK_BRAKE_POS) - 1) == 0) {
-        fbwVars.parkBrakePos = atof(&data[sizeof(A32NX_PARK_BRAKE_POS) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_XPNDR_MODE, sizeof(A32NX_XPNDR_MODE) - 1) == 0) {
-        fbwVars.xpndrMode = atof(&data[sizeof(A32NX_XPNDR_MODE) + 1]);
-    }
-    else if (strncmp(&data[1], A32NX_AUTOPILOT_1, sizeof(A32NX_AUTOPILOT_1) - 1) == 0) {
-        fbwVars.autopilot1 = atof(&data[sizeof(A32NX_AUTOPILOT_1) + 1]);
+
+    JetbridgePacket* packed = NULL;
+    int multiplier = 1;
+
+    for (int i = 0; reads[i].var; i++) {
+        if (batch->packetCount == MaxBatchPackets) {
+            printf("Too many Jetbridge reads, ignoring %s\n", reads[i].var);
+            continue;
+        }
+
+        if (reads[i].range > 0 && packed && packed->rate == reads[i].rate && multiplier * reads[i].range <= MaxPackedValue) {
+            int codeLen = appendPackedRead(packed->rpnCode, packed->codeLen, reads[i].var, reads[i].range, multiplier);
+            if (codeLen != -1) {
+                packed->codeLen = codeLen;
+                packed->count++;
+                multiplier *= reads[i].range;
+                continue;
+            }
+        }
+
+        JetbridgePacket* packet = &batch->packets[batch->packetCount];
+        batch->packetCount++;
+
+        if (reads[i].range > 0) {
+            packet->codeLen = appendPackedRead(packet->rpnCode, 0, reads[i].var, reads[i].range, 1);
+        }
+        else {
+            sprintf_s(packet->rpnCode, "(%s)", reads[i].var);
+            packet->codeLen = strlen(packet->rpnCode);
+        }
+        packet->reads = &reads[i];
+        packet->count = 1;
+        packet->panelMask = 0;
+        packet->rate = reads[i].rate;
+        packet->intervalMillis = LVarRates[reads[i].rate].baseMillis;
+        packet->boost = false;
+        packet->nextPoll = 0;
+        packet->lastValue = 0;
+        packet->clampLogged = 0;
+
+        // Packed reads must be next to each other in the list
+        if (reads[i].range > 0) {
+            packed = packet;
+            multiplier = reads[i].range;
+        }
+        else {
+            packed = NULL;
+        }
     }
-    else if (strncmp(&data[1], A32NX_AUTOPILOT_2, sizeof(A32NX_AUTOPILOT_2) - 1) == 0) {
-        fbwVars.autopilot2 = atof(&data[sizeof(A32NX_AUTOPILOT_2) + 1]);
+
+    // Only hash once all the reads have been packed
+    for (int i = 0; i < batch->packetCount; i++) {
+        JetbridgePacket* packet = &batch->packets[i];
+        packet->hash = hashCode(packet->rpnCode, packet->codeLen);
+
+        for (int j = 0; j < packet->count; j++) {
+            packet->panelMask |= readPanelMask(&packet->reads[j]);
+        }
+
+        int slot = packet->hash & (BatchHashSize - 1);
+        while (batch->hashSlots[slot] != -1) {
+            slot = (slot + 1) & (BatchHashSize - 1);
+        }
+        batch->hashSlots[slot] = i;
     }
-    else if (strncmp(&data[1], A32NX_AUTOTHRUST, sizeof(A32NX_AUTOTHRUST) - 1) == 0) {
-        fbwVars.autothrust = atof(&data[sizeof(A32NX_AUTOTHRUST) + 1]);
+}
+
+/// <summary>
+/// Stores the value or values a packet's reply carries.
+/// </summary>
+static void unpackReply(JetbridgePacket* packet, const char* data)
+{
+    double value = parseJetbridgeValue(&data[packet->codeLen]);
+
+    // Poll faster while the value is changing
+    const LVarRate* rate = &LVarRates[packet->rate];
+    if (value != packet->lastValue) {
+        packet->intervalMillis = rate->baseMillis;
+        packet->lastValue = value;
     }
-    else if (strncmp(&data[1], A32NX_TCAS_MODE, sizeof(A32NX_TCAS_MODE) - 1) == 0) {
-        simVars.jbTcasMode = atof(&data[sizeof(A32NX_TCAS_MODE) + 1]);
+    else if (packet->intervalMillis * 2 <= rate->maxMillis) {
+        packet->intervalMillis = packet->intervalMillis * 2;
     }
-    else if (strncmp(&data[1], A32NX_AUTOPILOT_HDG, sizeof(A32NX_AUTOPILOT_HDG) - 1) == 0) {
-        fbwVars.autopilotHeading = atof(&data[sizeof(A32NX_AUTOPILOT_HDG) + 1]);
+    else {
+        packet->intervalMillis = rate->maxMillis;
     }
-    else if (strncmp(&data[1], A32NX_AUTOPILOT_VS, sizeof(A32NX_AUTOPILOT_VS) - 1) == 0) {
-        fbwVars.autopilotVerticalSpeed = atof(&data[sizeof(A32NX_AUTOPILOT_VS) + 1]);
+
+    const JetbridgeRead* read = packet->reads;
+    long packedValue = (long)(value + 0.5);
+
+    for (int i = 0; i < packet->count; i++, read++) {
+        if (packet->count > 1) {
+            value = packedValue % read->range;
+            packedValue /= read->range;
+        }
+
+        // Ranges have a spare value at the top (except for bools) so
+        // reaching it means the real value was probably clamped.
+        if (read->range > 2 && value == read->range - 1 && (packet->clampLogged & (1 << i)) == 0) {
+            printf("Jetbridge %s reached the top of its packed range (%d), the range may be too small\n", read->var, read->range);
+            packet->clampLogged |= 1 << i;
+        }
+
+        if (read->target) {
+            *read->target = value;
+        }
+        else {
+            read->handler(value);
+        }
     }
-    else if (strncmp(&data[1], A32NX_AUTOPILOT_FPA, sizeof(A32NX_AUTOPILOT_FPA) - 1) == 0) {
-        fbwVars.autopilotFpa = atof(&data[sizeof(A32NX_AUTOPILOT_FPA) + 1]);
+}
+
+/// <summary>
+/// Called by the client with the reply to one of our reads or with
+/// NULL if it timed out.
+/// </summary>
+static void packetReply(void* context, const char* data)
+{
+    JetbridgePacket* packet = (JetbridgePacket*)context;
+
+    // Make sure it really is the reply to this packet
+    if (data && memcmp(data, packet->rpnCode, packet->codeLen) == 0) {
+        unpackReply(packet, data);
     }
-    else if (strncmp(&data[1], A32NX_MANAGED_SPEED, sizeof(A32NX_MANAGED_SPEED) - 1) == 0) {
-        simVars.jbManagedSpeed = atof(&data[sizeof(A32NX_MANAGED_SPEED) + 1]);
+
+    packet->inFlight = false;
+}
+
+static void batchRead(JetbridgeBatch* batch)
+{
+    jetbridgeClient->expireRequests();
+    ULONGLONG now = GetTickCount64();
+    int panels = activePanels;
+
+    // Don't ask again for anything that hasn't replied yet and only
+    // ask for what the connected panels need.
+    for (int i = 0; i < batch->packetCount; i++) {
+        JetbridgePacket* packet = &batch->packets[i];
+        if ((packet->panelMask & panels) == 0) {
+            continue;
+        }
+
+        if (packet->boost.exchange(false)) {
+            packet->intervalMillis = LVarRates[packet->rate].baseMillis;
+            packet->nextPoll = now;
+        }
+
+        if (packet->inFlight || now < packet->nextPoll) {
+            continue;
+        }
+
+        packet->nextPoll = now + packet->intervalMillis;
+        packet->inFlight = true;
+        if (!jetbridgeClient->request(packet->rpnCode, packetReply, packet)) {
+            packet->inFlight = false;
+        }
     }
-    else if (strncmp(&data[1], A32NX_MANAGED_HEADING, sizeof(A32NX_MANAGED_HEADING) - 1) == 0) {
-        simVars.jbManagedHeading = atof(&data[sizeof(A32NX_MANAGED_HEADING) + 1]);
+}
+
+/// <summary>
+/// Finds the packet a reply belongs to from its RPN code. Only used for
+/// replies that can't be matched by id, e.g. ones that arrive after
+/// their request timed out. Returns false if the reply isn't for one
+/// of our reads.
+/// </summary>
+static bool batchUpdate(JetbridgeBatch* batch, const char* data)
+{
+    // The value is on the end of the reply so work back to find where
+    // the RPN code finishes.
+    int valuePos = strnlen(data, jetbridge::kPacketDataSize);
+    while (valuePos > 0 && ((data[valuePos - 1] >= '0' && data[valuePos - 1] <= '9') || data[valuePos - 1] == '.')) {
+        valuePos--;
     }
-    else if (strncmp(&data[1], A32NX_MANAGED_ALTITUDE, sizeof(A32NX_MANAGED_ALTITUDE) - 1) == 0) {
-        simVars.jbManagedAltitude = atof(&data[sizeof(A32NX_MANAGED_ALTITUDE) + 1]);
+    if (valuePos > 0 && data[valuePos - 1] == '-') {
+        valuePos--;
     }
-    else if (strncmp(&data[1], A32NX_LATERAL_MODE, sizeof(A32NX_LATERAL_MODE) - 1) == 0) {
-        simVars.jbLateralMode = atof(&data[sizeof(A32NX_LATERAL_MODE) + 1]);
+
+    unsigned int hash = hashCode(data, valuePos);
+    int slot = hash & (BatchHashSize - 1);
+
+    for (; batch->hashSlots[slot] != -1; slot = (slot + 1) & (BatchHashSize - 1)) {
+        JetbridgePacket* packet = &batch->packets[batch->hashSlots[slot]];
+        if (packet->hash == hash && packet->codeLen == valuePos && memcmp(data, packet->rpnCode, valuePos) == 0) {
+            unpackReply(packet, data);
+            return true;
+        }
     }
-    else if (strncmp(&data[1], A32NX_VERTICAL_MODE, sizeof(A32NX_VERTICAL_MODE) - 1) == 0) {
-        simVars.jbVerticalMode = atof(&data[sizeof(A32NX_VERTICAL_MODE) + 1]);
+
+    return false;
+}
+
+/// <summary>
+/// Puts packets back to their base rate after a panel writes something
+/// they read. Pass NULL to boost everything that isn't slow, e.g. after
+/// a key event where we don't know which lvars it affects.
+/// </summary>
+static void batchBoost(JetbridgeBatch* batch, const char* var)
+{
+    for (int i = 0; i < batch->packetCount; i++) {
+        JetbridgePacket* packet = &batch->packets[i];
+        if (var == NULL) {
+            if (packet->rate != LVAR_SLOW) {
+                packet->boost = true;
+            }
+            continue;
+        }
+
+        for (int j = 0; j < packet->count; j++) {
+            if (strcmp(packet->reads[j].var, var) == 0) {
+                packet->boost = true;
+                return;
+            }
+        }
     }
-    else if (strncmp(&data[1], A32NX_LOC_MODE, sizeof(A32NX_LOC_MODE) - 1) == 0) {
-        simVars.jbLocMode = atof(&data[sizeof(A32NX_LOC_MODE) + 1]);
+}
+
+static void boostReads(const char* var)
+{
+    batchBoost(&a310Batch, var);
+    batchBoost(&fbwBatch, var);
+}
+
+/// <summary>
+/// Formats a value for RPN code. Most values are whole numbers or have
+/// a few decimal places so this avoids sprintf and keeps the code short.
+/// </summary>
+static int formatValue(char* buf, double val)
+{
+    if (val != val || val > 1e12 || val < -1e12) {
+        return sprintf_s(buf, jetbridge::kPacketDataSize, "%f", val);
     }
-    else if (strncmp(&data[1], A32NX_APPR_MODE, sizeof(A32NX_APPR_MODE) - 1) == 0) {
-        simVars.jbApprMode = atof(&data[sizeof(A32NX_APPR_MODE) + 1]);
+
+    int len = 0;
+    if (val < 0) {
+        buf[len++] = '-';
+        val = -val;
     }
-    else if (strncmp(&data[1], A32NX_AUTOTHRUST_MODE, sizeof(A32NX_AUTOTHRUST_MODE) - 1) == 0) {
-        simVars.jbAutothrustMode = atof(&data[sizeof(A32NX_AUTOTHRUST_MODE) + 1]);
+
+    // Same 6 decimal places as %f but with trailing zeros dropped
+    unsigned long long scaled = (unsigned long long)(val * 1000000 + 0.5);
+    unsigned long long whole = scaled / 1000000;
+    int fraction = (int)(scaled % 1000000);
+
+    char digits[24];
+    int digitCount = 0;
+    do {
+        digits[digitCount++] = '0' + (int)(whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+
+    while (digitCount > 0) {
+        buf[len++] = digits[--digitCount];
     }
-    else if (strncmp(&data[1], A32NX_AUTOBRAKE, sizeof(A32NX_AUTOBRAKE) - 1) == 0) {
-        simVars.jbAutobrake = atof(&data[sizeof(A32NX_AUTOBRAKE) + 1]);
+
+    if (fraction > 0) {
+        buf[len++] = '.';
+        for (int divisor = 100000; fraction > 0; divisor /= 10) {
+            buf[len++] = '0' + fraction / divisor;
+            fraction %= divisor;
+        }
     }
-    else if (strncmp(&data[1], A32NX_LEFT_BRAKEPEDAL, sizeof(A32NX_LEFT_BRAKEPEDAL) - 1) == 0) {
-        fbwVars.leftBrakePedal = atof(&data[sizeof(A32NX_LEFT_BRAKEPEDAL) + 1]);
+
+    buf[len] = '\0';
+    return len;
+}
+
+/// <summary>
+/// Renders the " (>K:EVENT)" part of every key event write once so
+/// writes only have to format the value.
+/// </summary>
+static void writeTemplatesInit()
+{
+    for (int i = 0; i < SIM_STOP && WriteEvents[i].name; i++) {
+        eventSuffixLen[i] = sprintf_s(eventSuffix[i], " (>K:%s)", WriteEvents[i].name);
     }
-    else if (strncmp(&data[1], A32NX_SPOILERS_HANDLE_POS, sizeof(A32NX_SPOILERS_HANDLE_POS) - 1) == 0) {
-        fbwVars.spoilersHandlePos = atof(&data[sizeof(A32NX_SPOILERS_HANDLE_POS) + 1]);
+}
+
+void jetbridgeInit(HANDLE hSimConnect)
+{
+    if (jetbridgeClient != 0) {
+        delete jetbridgeClient;
     }
-    else if (strncmp(&data[1], A32NX_RIGHT_BRAKEPEDAL, sizeof(A32NX_RIGHT_BRAKEPEDAL) - 1) == 0) {
-        fbwVars.rightBrakePedal = atof(&data[sizeof(A32NX_RIGHT_BRAKEPEDAL) + 1]);
+
+    jetbridgeClient = new jetbridge::Client(hSimConnect);
+
+    writeTemplatesInit();
+    batchInit(&a310Batch, A310Reads);
+    batchInit(&fbwBatch, FbwReads);
+}
+
+void readJetbridgeVar(const char* var)
+{
+    char rpnCode[128];
+    sprintf_s(rpnCode, "(%s)", var);
+    jetbridgeClient->request(rpnCode);
+    //printf("%s\n", rpnCode);
+}
+
+/// <summary>
+/// Adds a command to a program, sending what we have so far first if
+/// it won't fit in the packet.
+/// </summary>
+static void addCommand(RpnProgram* program, const char* value, int valueLen, const char* suffix, int suffixLen)
+{
+    int len = valueLen + suffixLen;
+    if (program->codeLen > 0 && program->codeLen + 1 + len >= jetbridge::kPacketDataSize) {
+        sendJetbridgeProgram(program);
     }
-    else if (strncmp(&data[1], A32NX_RUDDER_PEDAL_POS, sizeof(A32NX_RUDDER_PEDAL_POS) - 1) == 0) {
-        fbwVars.rudderPedalPos = atof(&data[sizeof(A32NX_RUDDER_PEDAL_POS) + 1]);
+
+    if (len >= jetbridge::kPacketDataSize) {
+        printf("Jetbridge command too long: %s%s\n", value, suffix);
+        return;
     }
-    else if (strncmp(&data[1], A32NX_ENGINE_EGT1, sizeof(A32NX_ENGINE_EGT1) - 1) == 0) {
-        fbwVars.engineEgt1 = atof(&data[sizeof(A32NX_ENGINE_EGT1) + 1]);
+
+    char* pos = &program->rpnCode[program->codeLen];
+    if (program->codeLen > 0) {
+        *pos++ = ' ';
+        program->codeLen++;
     }
-    else if (strncmp(&data[1], A32NX_ENGINE_EGT2, sizeof(A32NX_ENGINE_EGT2) - 1) == 0) {
-        fbwVars.engineEgt2 = atof(&data[sizeof(A32NX_ENGINE_EGT2) + 1]);
+
+    memcpy(pos, value, valueLen);
+    memcpy(pos + valueLen, suffix, suffixLen);
+    program->codeLen += len;
+    program->rpnCode[program->codeLen] = '\0';
+}
+
+void writeJetbridgeVar(RpnProgram* program, const char* var, double val)
+{
+    // FS2020 uses RPN (Reverse Polish Notation).
+    char value[jetbridge::kPacketDataSize];
+    int valueLen = formatValue(value, val);
+
+    char suffix[jetbridge::kPacketDataSize];
+    int suffixLen = sprintf_s(suffix, " (>%s)", var);
+
+    addCommand(program, value, valueLen, suffix, suffixLen);
+    boostReads(var);
+}
+
+void writeJetbridgeVar(RpnProgram* program, EVENT_ID eventId, double val)
+{
+    char value[jetbridge::kPacketDataSize];
+    int valueLen = formatValue(value, val);
+
+    addCommand(program, value, valueLen, eventSuffix[eventId], eventSuffixLen[eventId]);
+    boostReads(NULL);
+}
+
+void sendJetbridgeProgram(RpnProgram* program)
+{
+    if (program->codeLen == 0) {
+        return;
     }
-    else if (strncmp(&data[1], A32NX_ENGINE_FUEL_FLOW1, sizeof(A32NX_ENGINE_FUEL_FLOW1) - 1) == 0) {
-        fbwVars.engineFuelFlow1 = atof(&data[sizeof(A32NX_ENGINE_FUEL_FLOW1) + 1]);
+
+    jetbridgeClient->request(program->rpnCode);
+#ifdef DEBUG_WRITES
+    printf("%s\n", program->rpnCode);
+#endif
+    program->codeLen = 0;
+}
+
+void writeJetbridgeVar(const char* var, double val)
+{
+    RpnProgram program = {};
+    writeJetbridgeVar(&program, var, val);
+    sendJetbridgeProgram(&program);
+}
+
+void writeJetbridgeVar(EVENT_ID eventId, double val)
+{
+    RpnProgram program = {};
+    writeJetbridgeVar(&program, eventId, val);
+    sendJetbridgeProgram(&program);
+}
+
+void writeJetbridgeHvar(const char* var)
+{
+    char rpnCode[128];
+    sprintf_s(rpnCode, "(>H:%s)", var);
+    jetbridgeClient->request(rpnCode);
+    boostReads(NULL);
+#ifdef DEBUG_WRITES
+    printf("%s\n", rpnCode);
+#endif
+}
+
+void writeJetbridge_Fbw_CabinLights(double val)
+{
+    const char rpnPotentiometer[] = " (>K:2:LIGHT_POTENTIOMETER_SET)";
+    const int OVERHEAD_INTEG_LIGHT = 86;
+    const int GLARESHIELD_INTEG_LIGHT = 84;
+    const int GLARESHIELD_LCD_LIGHT = 87;
+    const int FLOOD_LIGHT_CPT = 83;
+    const int FLOOD_LIGHT_FO = 76;
+    const int INTEG_LIGHT = 85;
+
+    const int potentiometers[] = {
+        OVERHEAD_INTEG_LIGHT, GLARESHIELD_INTEG_LIGHT, GLARESHIELD_LCD_LIGHT,
+        FLOOD_LIGHT_CPT, FLOOD_LIGHT_FO, INTEG_LIGHT
+    };
+
+    // Params are "value index" and the value is the same for all of them
+    char params[jetbridge::kPacketDataSize];
+    int valueLen = formatValue(params, val);
+    params[valueLen] = ' ';
+
+    RpnProgram program = {};
+    for (int potentiometer : potentiometers) {
+        int paramsLen = valueLen + 1 + formatValue(&params[valueLen + 1], potentiometer);
+        addCommand(&program, params, paramsLen, rpnPotentiometer, sizeof(rpnPotentiometer) - 1);
     }
-    else if (strncmp(&data[1], A32NX_ENGINE_FUEL_FLOW2, sizeof(A32NX_ENGINE_FUEL_FLOW2) - 1) == 0) {
-        fbwVars.engineFuelFlow2 = atof(&data[sizeof(A32NX_ENGINE_FUEL_FLOW2) + 1]);
+    sendJetbridgeProgram(&program);
+}
+
+bool jetbridgeReply(const jetbridge::Packet* packet)
+{
+    return jetbridgeClient->handleReply(packet);
+}
+
+jetbridge::ClientStats jetbridgeStats()
+{
+    return jetbridgeClient->getStats();
+}
+
+void updateA310FromJetbridge(const char* data)
+{
+    if (!batchUpdate(&a310Batch, data) && strncmp(data, "write", 5) != 0) {
+        printf("Uknown A310 from Jetbridge: %s\n", data);
     }
-    else if (strncmp(data, "write", 5) != 0) {
+}
+
+void updateFbwFromJetbridge(const char* data)
+{
+    if (!batchUpdate(&fbwBatch, data) && strncmp(data, "write", 5) != 0) {
         printf("Uknown Fbw from Jetbridge: %s\n", data);
     }
 }
@@ -342,9 +815,13 @@ bool jetbridgeA310ButtonPress(int eventId, double value)
         writeJetbridgeVar(A310_ELEC_BAT1, value);
         return true;
     case KEY_ELEC_BAT2:
-        writeJetbridgeVar(A310_ELEC_BAT2, value);
-        writeJetbridgeVar(A310_ELEC_BAT3, value);
+    {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_ELEC_BAT2, value);
+        writeJetbridgeVar(&program, A310_ELEC_BAT3, value);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE:
         // Toggle
         writeJetbridgeVar(A310_SEATBELTS_SWITCH, 1 - a310Vars.seatbeltsSwitch);
@@ -352,24 +829,40 @@ bool jetbridgeA310ButtonPress(int eventId, double value)
     case KEY_BEACON_LIGHTS_SET:
         // Off = 0, On = 1
         a310Vars.beaconLights = value;
+        writeJetbridgeVar(A310_BEACON_LIGHTS, a310Vars.beaconLights);
         return true;
     case KEY_LANDING_LIGHTS_SET:
+    {
         // On = 0, Off = 2
         a310Vars.landingLights = 2 - value * 2;
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_LANDING_LIGHTS_L, a310Vars.landingLights);
+        writeJetbridgeVar(&program, A310_LANDING_LIGHTS_R, a310Vars.landingLights);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_TAXI_LIGHTS_SET:
+    {
         // T.O. = 0, Taxi = 1, Off = 2
         a310Vars.taxiLights = 2 - value * 2;
         // Off = 0, On = 1
         a310Vars.turnoffLights = value;
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_TAXI_LIGHTS, a310Vars.taxiLights);
+        writeJetbridgeVar(&program, A310_TURNOFF_LIGHTS_L, a310Vars.turnoffLights);
+        writeJetbridgeVar(&program, A310_TURNOFF_LIGHTS_R, a310Vars.turnoffLights);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_NAV_LIGHTS_SET:
         // On = 0, Off = 2
         a310Vars.navLights = 2 - value * 2;
+        writeJetbridgeVar(A310_NAV_LIGHTS, a310Vars.navLights);
         return true;
     case KEY_STROBES_SET:
         // On = 0, Off = 2
         a310Vars.strobes = 2 - value * 2;
+        writeJetbridgeVar(A310_STROBES, a310Vars.strobes);
         return true;
     case KEY_XPNDR_HIGH_SET:
         if (value == 1) {
@@ -473,8 +966,10 @@ bool jetbridgeA310ButtonPress(int eventId, double value)
     {
         int mhz = int(value);
         int khz = int((0.005 + value - mhz) * 100);
-        writeJetbridgeVar(A310_ILS_SET_FREQUENCY_MHZ, mhz);
-        writeJetbridgeVar(A310_ILS_SET_FREQUENCY_KHZ, khz);
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A310_ILS_SET_FREQUENCY_MHZ, mhz);
+        writeJetbridgeVar(&program, A310_ILS_SET_FREQUENCY_KHZ, khz);
+        sendJetbridgeProgram(&program);
         return true;
     }
     case KEY_VOR1_SET:
@@ -498,30 +993,46 @@ bool jetbridgeFbwButtonPress(int eventId, double value)
         writeJetbridgeVar(A32NX_APU_BLEED, value);
         return true;
     case KEY_ELEC_BAT1:
-        writeJetbridgeVar(A32NX_ELEC_BAT1, value);
-        writeJetbridgeVar(A32NX_ELEC_BAT_ESS, value);
+    {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A32NX_ELEC_BAT1, value);
+        writeJetbridgeVar(&program, A32NX_ELEC_BAT_ESS, value);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_ELEC_BAT2:
-        writeJetbridgeVar(A32NX_ELEC_BAT2, value);
-        writeJetbridgeVar(A32NX_ELEC_BAT_APU, value);
+    {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A32NX_ELEC_BAT2, value);
+        writeJetbridgeVar(&program, A32NX_ELEC_BAT_APU, value);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_AUTOBRAKE:
         writeJetbridgeVar(A32NX_AUTOBRAKE, value);
         return true;
     case KEY_XPNDR_STATE:
+    {
         // Set transponder to standby or auto
-        writeJetbridgeVar(A32NX_XPNDR_MODE, value);
-        writeJetbridgeVar(A32NX_TCAS_MODE, value * 2);
-        writeJetbridgeVar(A32NX_TCAS_SWITCH, value * 2);
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A32NX_XPNDR_MODE, value);
+        writeJetbridgeVar(&program, A32NX_TCAS_MODE, value * 2);
+        writeJetbridgeVar(&program, A32NX_TCAS_SWITCH, value * 2);
+        sendJetbridgeProgram(&program);
         return true;
+    }
     case KEY_CABIN_LIGHTS_SET:
         writeJetbridge_Fbw_CabinLights(value);
         return true;
     case KEY_AP_ALT_VAR_SET_ENGLISH:
-        writeJetbridgeVar(A32NX_FCU_ALT_INCREMENT_SET, 100);
-        writeJetbridgeVar(A32NX_FCU_ALT_SET, value);
+    {
+        RpnProgram program = {};
+        writeJetbridgeVar(&program, A32NX_FCU_ALT_INCREMENT_SET, 100);
+        writeJetbridgeVar(&program, A32NX_FCU_ALT_SET, value);
+        sendJetbridgeProgram(&program);
         return true;
     }
+    }
     return false;
 }
 
@@ -574,76 +1085,12 @@ bool jetbridgeMiscButtonPress(int eventId, double value)
 
 void readA310Jetbridge()
 {
-    readJetbridgeVar(A310_APU_MASTER_SW);
-    readJetbridgeVar(A310_APU_START);
-    readJetbridgeVar(A310_APU_START_AVAIL);
-    readJetbridgeVar(A310_APU_BLEED);
-    readJetbridgeVar(A310_ELEC_BAT1);
-    readJetbridgeVar(A310_ELEC_BAT2);
-    readJetbridgeVar(A310_SEATBELTS_SWITCH);
-    readJetbridgeVar(A310_BEACON_LIGHTS);
-    readJetbridgeVar(A310_LANDING_LIGHTS_L);
-    readJetbridgeVar(A310_TAXI_LIGHTS);
-    readJetbridgeVar(A310_TURNOFF_LIGHTS_L);
-    readJetbridgeVar(A310_NAV_LIGHTS);
-    readJetbridgeVar(A310_STROBES);
-    readJetbridgeVar(A310_PITCH_TRIM1);
-    readJetbridgeVar(A310_PITCH_TRIM2);
-    readJetbridgeVar(A310_TCAS_MODE);
-    readJetbridgeVar(A310_AP_AIRSPEED);
-    readJetbridgeVar(A310_AP_IS_MACH);
-    readJetbridgeVar(A310_AP_HEADING);
-    readJetbridgeVar(A310_AP_ALTITUDE);
-    readJetbridgeVar(A310_AP_VERTICALSPEED);
-    readJetbridgeVar(A310_AUTOBRAKE);
-    readJetbridgeVar(A310_FLIGHTDIRECTOR);
-    readJetbridgeVar(A310_AUTOPILOT);
-    readJetbridgeVar(A310_AUTOTHROTTLE);
-    readJetbridgeVar(A310_LOCALISER);
-    readJetbridgeVar(A310_APPROACH);
-    readJetbridgeVar(A310_ENG_IGNITION);
-    readJetbridgeVar(A310_HEADING_MODE);
-    readJetbridgeVar(A310_PITCH_MODE);
-    readJetbridgeVar(A310_GEAR_HANDLE);
-    readJetbridgeVar(A310_ILS_FREQUENCY);
-    readJetbridgeVar(A310_ILS_COURSE);
+    batchRead(&a310Batch);
 }
 
 void readFbwJetbridge()
 {
-    readJetbridgeVar(A32NX_APU_MASTER_SW);
-    readJetbridgeVar(A32NX_APU_START);
-    readJetbridgeVar(A32NX_APU_START_AVAIL);
-    readJetbridgeVar(A32NX_APU_BLEED);
-    readJetbridgeVar(A32NX_ELEC_BAT1);
-    readJetbridgeVar(A32NX_ELEC_BAT2);
-    readJetbridgeVar(A32NX_FLAPS_INDEX);
-    readJetbridgeVar(A32NX_PARK_BRAKE_POS);
-    readJetbridgeVar(A32NX_SPOILERS_HANDLE_POS);
-    readJetbridgeVar(A32NX_XPNDR_MODE);
-    readJetbridgeVar(A32NX_AUTOPILOT_1);
-    readJetbridgeVar(A32NX_AUTOPILOT_2);
-    readJetbridgeVar(A32NX_AUTOTHRUST);
-    readJetbridgeVar(A32NX_TCAS_MODE);
-    readJetbridgeVar(A32NX_MANAGED_SPEED);
-    readJetbridgeVar(A32NX_MANAGED_HEADING);
-    readJetbridgeVar(A32NX_MANAGED_ALTITUDE);
-    readJetbridgeVar(A32NX_LATERAL_MODE);
-    readJetbridgeVar(A32NX_VERTICAL_MODE);
-    readJetbridgeVar(A32NX_LOC_MODE);
-    readJetbridgeVar(A32NX_APPR_MODE);
-    readJetbridgeVar(A32NX_AUTOTHRUST_MODE);
-    readJetbridgeVar(A32NX_AUTOBRAKE);
-    readJetbridgeVar(A32NX_LEFT_BRAKEPEDAL);
-    readJetbridgeVar(A32NX_RIGHT_BRAKEPEDAL);
-    readJetbridgeVar(A32NX_RUDDER_PEDAL_POS);
-    readJetbridgeVar(A32NX_AUTOPILOT_HDG);
-    readJetbridgeVar(A32NX_AUTOPILOT_VS);
-    readJetbridgeVar(A32NX_AUTOPILOT_FPA);
-    readJetbridgeVar(A32NX_ENGINE_EGT1);
-    readJetbridgeVar(A32NX_ENGINE_EGT2);
-    readJetbridgeVar(A32NX_ENGINE_FUEL_FLOW1);
-    readJetbridgeVar(A32NX_ENGINE_FUEL_FLOW2);
+    batchRead(&fbwBatch);
 }
 
 #endif  // jetbridgeFallback
@@ -0,0 +1,151 @@
+#include <stddef.h>
+#include "sessions.h"
+
+Session sessions[MaxSessions];
+std::atomic<int> activePanels(0);
+bool sessionsFull = false;
+
+void sessionsInit()
+{
+    for (int i = 0; i < MaxSessions; i++) {
+        sessions[i].inUse = false;
+        sessions[i].connected = false;
+        sessions[i].subscribed = false;
+        sessions[i].frameNo = 0;
+        sessions[i].deltaV2 = false;
+    }
+    activePanels = 0;
+}
+
+const char* panelName(PANEL_TYPE panelType)
+{
+    switch (panelType) {
+    case AUTOPILOT_PANEL: return "Autopilot panel";
+    case RADIO_PANEL: return "Radio panel";
+    case LIGHTS_PANEL: return "Power/Lights panel";
+    default: return "Instrument panel";
+    }
+}
+
+/// <summary>
+/// Some panels request less data to save bandwidth.
+/// </summary>
+long panelDataSize(PANEL_TYPE panelType)
+{
+    switch (panelType) {
+    case AUTOPILOT_PANEL: return (long)(offsetof(SimVars, autothrottleActive) + sizeof(double));
+    case RADIO_PANEL: return (long)(offsetof(SimVars, transponderCode) + sizeof(double));
+    case LIGHTS_PANEL: return (long)(offsetof(SimVars, apuPercentRpm) + sizeof(double));
+    default: return (long)sizeof(SimVars);
+    }
+}
+
+/// <summary>
+/// Returns the session for the panel at the given address and port,
+/// creating a new one if this panel hasn't polled us before. A new
+/// session is not connected so the caller knows to send full data.
+/// Returns NULL if all sessions are in use.
+/// </summary>
+Session* findSession(sockaddr_in* addr, PANEL_TYPE panelType)
+{
+    Session* freeSession = NULL;
+    ULONGLONG now = GetTickCount64();
+
+    for (int i = 0; i < MaxSessions; i++) {
+        Session* session = &sessions[i];
+
+        if (!session->inUse) {
+            if (!freeSession) {
+                freeSession = session;
+            }
+            continue;
+        }
+
+        if (session->addr.sin_addr.s_addr == addr->sin_addr.s_addr && session->addr.sin_port == addr->sin_port) {
+            if (session->panelType != panelType) {
+                // Same client is now asking for a different panel's data
+                session->panelType = panelType;
+                session->connected = false;
+                session->subscribed = false;
+            }
+            session->lastRequest = now;
+            activePanels |= 1 << panelType;
+            return session;
+        }
+    }
+
+    if (!freeSession) {
+        if (!sessionsFull) {
+            printf("Too many panels connected (max %d)\n", MaxSessions);
+            sessionsFull = true;
+        }
+        return NULL;
+    }
+
+    freeSession->inUse = true;
+    freeSession->connected = false;
+    freeSession->subscribed = false;
+    freeSession->addr = *addr;
+    freeSession->panelType = panelType;
+    freeSession->lastRequest = now;
+    sessionsFull = false;
+    activePanels |= 1 << panelType;
+
+    return freeSession;
+}
+
+/// <summary>
+/// Panel wants data pushed to it rather than polling for it.
+/// </summary>
+void subscribe(Session* session, double maxPerSecond)
+{
+    if (maxPerSecond > 0) {
+        session->pushIntervalMillis = (ULONGLONG)(1000 / maxPerSecond);
+    }
+    else {
+        session->pushIntervalMillis = 0;
+    }
+
+    if (!session->subscribed) {
+        printf("%s at %s:%d subscribed\n", panelName(session->panelType),
+            inet_ntoa(session->addr.sin_addr), ntohs(session->addr.sin_port));
+        session->subscribed = true;
+        session->lastPush = 0;
+    }
+}
+
+/// <summary>
+/// Drop any panel that has stopped polling. Returns the number
+/// of sessions that are still active.
+/// </summary>
+int expireSessions()
+{
+    ULONGLONG now = GetTickCount64();
+    int activeCount = 0;
+    int panels = 0;
+
+    for (int i = 0; i < MaxSessions; i++) {
+        Session* session = &sessions[i];
+
+        if (!session->inUse) {
+            continue;
+        }
+
+        if (now - session->lastRequest > SessionTimeoutMillis) {
+            if (session->connected) {
+                printf("%s disconnected from %s:%d\n", panelName(session->panelType),
+                    inet_ntoa(session->addr.sin_addr), ntohs(session->addr.sin_port));
+            }
+            session->inUse = false;
+            session->connected = false;
+            session->subscribed = false;
+        }
+        else {
+            activeCount++;
+            panels |= 1 << session->panelType;
+        }
+    }
+
+    activePanels = panels;
+    return activeCount;
+}
@@ -186,6 +186,134 @@ const char* SimVarDefs[][2] = {
     { NULL, NULL }
 };
 
+// Vars that get overwritten when aircraft specific vars are mapped to real
+// vars. SimConnect isn't the only thing that changes these.
+const char* MappedVars[] = {
+    "Brake Parking Position",
+    "Flaps Handle Index",
+    "Apu Switch",
+    "Apu Pct Rpm",
+    "Nav Active Frequency:1",
+    "Nav Standby Frequency:1",
+    "Cabin Seatbelts Alert Switch",
+    "Transponder State:1",
+    "Autopilot Master",
+    "Autopilot Flight Director Active",
+    "Autopilot Heading Lock Dir",
+    "Autopilot Heading Lock",
+    "Autopilot Altitude Lock Var",
+    "Autopilot Vertical Hold Var",
+    "Autopilot Vertical Hold",
+    "Autopilot Airspeed Hold Var",
+    "Autopilot Mach Hold Var",
+    "Autopilot Approach Hold",
+    "Autopilot Glideslope Hold",
+    "Autothrottle Active",
+    "Spoilers Handle Position",
+    "Auto Brake Switch Cb",
+    "Nav Obs:1",
+    "Rudder Position",
+    "Brake Left Position",
+    "Brake Right Position",
+    "General Eng Exhaust Gas Temperature:1",
+    "General Eng Exhaust Gas Temperature:2",
+    "Eng Fuel Flow GPH:1",
+    "Eng Fuel Flow GPH:2",
+    "Suction Pressure",
+    NULL
+};
+
+// Vars that don't need to be read on every frame. Mapped vars must not be
+// listed here as they would be left with the mapped value.
+VarRate VarRates[] = {
+    { "Title", RATE_CHANGED },
+    { "Estimated Cruise Speed", RATE_CHANGED },
+    { "Flaps Num Handle Positions", RATE_CHANGED },
+    { "Autopilot Available", RATE_CHANGED },
+    { "Airspeed True Calibrate", RATE_CHANGED },
+    { "Ambient Temperature", RATE_SECOND },
+    { "Number Of Engines", RATE_CHANGED },
+    { "General Eng Elapsed Time:1", RATE_SECOND },
+    { "Fuel Total Capacity", RATE_CHANGED },
+    { "Fuel Total Quantity", RATE_SECOND },
+    { "Fuel Tank Left Main Level", RATE_SECOND },
+    { "Fuel Tank Right Main Level", RATE_SECOND },
+    { "Is Gear Retractable", RATE_CHANGED },
+    { "General Eng Oil Temperature:1", RATE_SECOND },
+    { "General Eng Oil Temperature:2", RATE_SECOND },
+    { "General Eng Oil Temperature:3", RATE_SECOND },
+    { "General Eng Oil Temperature:4", RATE_SECOND },
+    { "General Eng Oil Pressure:1", RATE_SECOND },
+    { "General Eng Oil Pressure:2", RATE_SECOND },
+    { "General Eng Oil Pressure:3", RATE_SECOND },
+    { "General Eng Oil Pressure:4", RATE_SECOND },
+    { "Engine Type", RATE_CHANGED },
+    { "Max Rated Engine RPM", RATE_CHANGED },
+    { "Atc Id", RATE_CHANGED },
+    { "Atc Airline", RATE_CHANGED },
+    { "Atc Flight Number", RATE_CHANGED },
+    { "Atc Heavy", RATE_CHANGED },
+    { NULL, RATE_FRAME }
+};
+
+// Some vars change in the last few digits on every frame even though the
+// panels can't display the difference. These are only sent when they move
+// further than their deadband from the value the panels were last sent.
+VarDeadband VarDeadbands[] = {
+    { "Indicated Altitude", 0.5 },
+    { "Airspeed Indicated", 0.05 },
+    { "Airspeed Mach", 0.0005 },
+    { "Plane Heading Degrees Magnetic", 0.05 },
+    { "Vertical Speed", 0.1 },
+    { "General Eng Throttle Lever Position:1", 0.1 },
+    { "Attitude Indicator Pitch Degrees", 0.05 },
+    { "Attitude Indicator Bank Degrees", 0.05 },
+    { "Airspeed True", 0.05 },
+    { "Plane Heading Degrees True", 0.05 },
+    { "Plane Alt Above Ground", 0.5 },
+    { "Turn Indicator Rate", 0.01 },
+    { "Turn Coordinator Ball", 0.002 },
+    { "Ambient Temperature", 0.05 },
+    { "General Eng Rpm:1", 1 },
+    { "Eng Rpm Animation Percent:1", 0.05 },
+    { "Fuel Total Quantity", 0.01 },
+    { "Fuel Tank Left Main Level", 0.01 },
+    { "Fuel Tank Right Main Level", 0.01 },
+    { "Nav Radial Error:1", 0.05 },
+    { "Nav Glide Slope Error:1", 0.01 },
+    { "Nav Radial Error:2", 0.05 },
+    { "Nav Localizer:1", 0.05 },
+    { "Gps Wp Cross Trk", 0.5 },
+    { "Adf Radial:1", 0.1 },
+    { "Adf Card", 0.1 },
+    { "Rudder Position", 0.002 },
+    { "General Eng Oil Temperature:1", 0.1 },
+    { "General Eng Oil Temperature:2", 0.1 },
+    { "General Eng Oil Temperature:3", 0.1 },
+    { "General Eng Oil Temperature:4", 0.1 },
+    { "General Eng Oil Pressure:1", 0.1 },
+    { "General Eng Oil Pressure:2", 0.1 },
+    { "General Eng Oil Pressure:3", 0.1 },
+    { "General Eng Oil Pressure:4", 0.1 },
+    { "General Eng Exhaust Gas Temperature:1", 0.5 },
+    { "General Eng Exhaust Gas Temperature:2", 0.5 },
+    { "General Eng Exhaust Gas Temperature:3", 0.5 },
+    { "General Eng Exhaust Gas Temperature:4", 0.5 },
+    { "Turb Eng N1:1", 0.05 },
+    { "Turb Eng N1:2", 0.05 },
+    { "Turb Eng N1:3", 0.05 },
+    { "Turb Eng N1:4", 0.05 },
+    { "Prop RPM:1", 1 },
+    { "Eng Manifold Pressure:1", 0.01 },
+    { "Eng Fuel Flow GPH:1", 0.05 },
+    { "Eng Fuel Flow GPH:2", 0.05 },
+    { "Eng Fuel Flow GPH:3", 0.05 },
+    { "Eng Fuel Flow GPH:4", 0.05 },
+    { "Suction Pressure", 0.01 },
+    { "G Force", 0.005 },
+    { NULL, 0 }
+};
+
 WriteEvent WriteEvents[] = {
     { SIM_START, "DUMMY" },
     { KEY_CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE, "CABIN_SEATBELTS_ALERT_SWITCH_TOGGLE" },
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include "stageTiming.h"
+
+const char* StageNames[STAGE_COUNT] = { "Writes", "Timers", "Dispatch", "Handoff", "Send" };
+
+StageTiming stageTimings[STAGE_COUNT];
+double ticksPerMicro = 1;
+
+void stageTimingInit()
+{
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stageTimings[i].count = 0;
+        stageTimings[i].totalMicros = 0;
+        stageTimings[i].maxMicros = 0;
+    }
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    ticksPerMicro = freq.QuadPart / 1000000.0;
+}
+
+LONGLONG stageStart()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+/// <summary>
+/// Record the time since start (from stageStart) against the stage.
+/// </summary>
+void stageDone(STAGE stage, LONGLONG start)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    double micros = (now.QuadPart - start) / ticksPerMicro;
+    StageTiming* timing = &stageTimings[stage];
+    timing->count++;
+    timing->totalMicros += micros;
+    if (micros > timing->maxMicros) {
+        timing->maxMicros = micros;
+    }
+}
+
+/// <summary>
+/// Timings are totals since startup as stages belong to different
+/// threads so can't safely be reset from here.
+/// </summary>
+void showStageTimings()
+{
+    printf("Stages:");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageTiming* timing = &stageTimings[i];
+        if (timing->count > 0) {
+            printf(" %s = %.0f/%.0f us", StageNames[i], timing->totalMicros / timing->count, timing->maxMicros);
+        }
+    }
+    printf(" (Avg/Max)\n");
+}
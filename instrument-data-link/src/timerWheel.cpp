@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include "timerWheel.h"
+
+struct Timer {
+    unsigned long long due;
+    TimerCallback callback;
+    int arg;
+    int next;       // Next timer in the same slot (or free list)
+};
+
+Timer timers[MaxTimers];
+int wheel[TimerSlots];          // First timer in each slot (-1 = none)
+int freeTimers;
+int activeTimers;
+unsigned long long wheelTick;   // Next slot to run
+unsigned long long wheelNow;    // Time runTimers was last called with
+TimerTickCallback tickCallback = NULL;
+bool tickWanted;
+
+void timerWheelInit(unsigned long long now)
+{
+    for (int i = 0; i < MaxTimers; i++) {
+        timers[i].next = i + 1;
+    }
+    timers[MaxTimers - 1].next = -1;
+    freeTimers = 0;
+    activeTimers = 0;
+
+    for (int i = 0; i < TimerSlots; i++) {
+        wheel[i] = -1;
+    }
+    wheelTick = now / TimerSlotMillis;
+    wheelNow = now;
+    tickWanted = false;
+}
+
+/// <summary>
+/// Call callback(arg) once delayMillis has passed. Returns false if
+/// there are too many timers waiting.
+/// </summary>
+bool scheduleTimer(unsigned long long now, unsigned long delayMillis, TimerCallback callback, int arg)
+{
+    if (freeTimers == -1) {
+        printf("Too many timers (max %d)\n", MaxTimers);
+        return false;
+    }
+
+    int timerNum = freeTimers;
+    Timer* timer = &timers[timerNum];
+    freeTimers = timer->next;
+
+    timer->due = now + delayMillis;
+    timer->callback = callback;
+    timer->arg = arg;
+
+    // Never put a timer in a slot that has already been run
+    unsigned long long tick = timer->due / TimerSlotMillis;
+    if (tick < wheelTick) {
+        tick = wheelTick;
+    }
+
+    int slot = (int)(tick % TimerSlots);
+    timer->next = wheel[slot];
+    wheel[slot] = timerNum;
+    activeTimers++;
+
+    return true;
+}
+
+static void runTickCallback(unsigned long long now)
+{
+    tickWanted = tickCallback && tickCallback(now);
+}
+
+/// <summary>
+/// Run every timer that is due. Returns the number of timers run.
+/// </summary>
+int runTimers(unsigned long long now)
+{
+    wheelNow = now;
+
+    if (activeTimers == 0) {
+        wheelTick = now / TimerSlotMillis;
+        runTickCallback(now);
+        return 0;
+    }
+
+    int due[MaxTimers];
+    TimerCallback callbacks[MaxTimers];
+    int args[MaxTimers];
+    int dueCount = 0;
+    unsigned long long nowTick = now / TimerSlotMillis;
+
+    // Only need to visit each slot once however long it's been
+    unsigned long long lastTick = nowTick;
+    if (lastTick - wheelTick >= TimerSlots) {
+        lastTick = wheelTick + TimerSlots - 1;
+    }
+
+    for (unsigned long long tick = wheelTick; tick <= lastTick; tick++) {
+        int* prevNext = &wheel[tick % TimerSlots];
+        while (*prevNext != -1) {
+            Timer* timer = &timers[*prevNext];
+            if (timer->due <= now) {
+                // Unlink it (a timer further than one turn away stays put)
+                due[dueCount++] = *prevNext;
+                *prevNext = timer->next;
+            }
+            else {
+                prevNext = &timer->next;
+            }
+        }
+    }
+
+    // The current slot may still have timers due later this tick
+    wheelTick = nowTick;
+
+    // Free the timers before calling them so callbacks can schedule more
+    for (int i = 0; i < dueCount; i++) {
+        Timer* timer = &timers[due[i]];
+        callbacks[i] = timer->callback;
+        args[i] = timer->arg;
+        timer->next = freeTimers;
+        freeTimers = due[i];
+        activeTimers--;
+    }
+
+    for (int i = 0; i < dueCount; i++) {
+        callbacks[i](args[i]);
+    }
+
+    runTickCallback(now);
+    return dueCount;
+}
+
+/// <summary>
+/// Returns how long until the next timer is due (0xFFFFFFFF if none)
+/// so a caller can wait for exactly that long.
+/// </summary>
+unsigned long nextTimerMillis(unsigned long long now)
+{
+    if (activeTimers == 0) {
+        return tickWanted ? TimerSlotMillis : 0xFFFFFFFF;
+    }
+
+    unsigned long long nextDue = 0xFFFFFFFFFFFFFFFFULL;
+    for (int slot = 0; slot < TimerSlots; slot++) {
+        for (int timerNum = wheel[slot]; timerNum != -1; timerNum = timers[timerNum].next) {
+            if (timers[timerNum].due < nextDue) {
+                nextDue = timers[timerNum].due;
+            }
+        }
+    }
+
+    if (nextDue <= now) {
+        return 0;
+    }
+
+    if (tickWanted && nextDue - now > TimerSlotMillis) {
+        return TimerSlotMillis;
+    }
+
+    return (unsigned long)(nextDue - now);
+}
+
+/// <summary>
+/// The time runTimers was last called with, so a timer callback can
+/// schedule another timer without reading the clock itself.
+/// </summary>
+unsigned long long timerNow()
+{
+    return wheelNow;
+}
+
+/// <summary>
+/// Something that needs to run every tick, e.g. to retry work that
+/// couldn't get a timer because too many were waiting.
+/// </summary>
+void setTimerTickCallback(TimerTickCallback callback)
+{
+    tickCallback = callback;
+}
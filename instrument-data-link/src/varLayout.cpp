@@ -0,0 +1,171 @@
+#include "varLayout.h"
+#include "sessions.h"
+
+extern const char* SimVarDefs[][2];
+extern const char* MappedVars[];
+extern VarRate VarRates[];
+extern VarDeadband VarDeadbands[];
+
+VarLayout varLayout[MaxVars];
+int varCount = 0;
+int wordCount = 0;
+short wordVar[MaxWords];
+short deadbandVars[MaxVars];
+int deadbandCount = 0;
+
+static VarLayout* findVar(const char* name)
+{
+    for (int i = 0; i < varCount; i++) {
+        if (strcmp(varLayout[i].name, name) == 0) {
+            return &varLayout[i];
+        }
+    }
+
+    return NULL;
+}
+
+/// <summary>
+/// Work out the type, size, offset and panels for every var. Returns
+/// false if SimVarDefs doesn't match the SimVars struct.
+/// </summary>
+bool varLayoutInit()
+{
+    bool isValid = true;
+    bool foundSimConnect = false;
+    bool foundInternal = false;
+
+    // Skip 'connected' var
+    int offset = sizeof(double);
+    varCount = 0;
+
+    for (int i = 0;; i++) {
+        if (SimVarDefs[i][0] == NULL) {
+            break;
+        }
+
+        if (varCount == MaxVars) {
+            printf("ERROR: Too many SimVarDefs - Increase MaxVars\n");
+            return false;
+        }
+
+        VarLayout* var = &varLayout[varCount];
+        var->name = SimVarDefs[i][0];
+        var->units = SimVarDefs[i][1];
+        var->offset = offset;
+        var->size = sizeof(double);
+
+        if (_stricmp(var->units, "internal") == 0) {
+            var->kind = VAR_INTERNAL;
+            foundInternal = true;
+        }
+        else if (foundInternal) {
+            printf("ERROR: Internal variables must come last. Cannot add: %s\n", var->name);
+            isValid = false;
+        }
+        else if (_stricmp(var->units, "jetbridge") == 0) {
+            var->kind = VAR_JETBRIDGE;
+            if (foundSimConnect) {
+                printf("ERROR: Jetbridge variables must come first. Cannot add: %s\n", var->name);
+                isValid = false;
+            }
+        }
+        else if (_strnicmp(var->units, "string", 6) == 0) {
+            if (strcmp(var->units, "string32") != 0) {
+                printf("Unsupported string type: %s\n", var->units);
+            }
+            var->kind = VAR_STRING32;
+            var->size = 32;
+        }
+        else {
+            var->kind = VAR_DOUBLE;
+        }
+
+        if (var->kind == VAR_DOUBLE || var->kind == VAR_STRING32) {
+            foundSimConnect = true;
+        }
+
+        var->deadband = 0;
+        var->rate = RATE_FRAME;
+        var->mapped = false;
+        var->panelMask = 0;
+        for (int panel = 0; panel <= LIGHTS_PANEL; panel++) {
+            if (offset < panelDataSize((PANEL_TYPE)panel)) {
+                var->panelMask |= 1 << panel;
+            }
+        }
+
+        offset += var->size;
+        varCount++;
+    }
+
+    // Mark mapped vars
+    for (int i = 0; MappedVars[i] != NULL; i++) {
+        VarLayout* var = findVar(MappedVars[i]);
+        if (!var) {
+            printf("ERROR: Unknown mapped var: %s\n", MappedVars[i]);
+            isValid = false;
+        }
+        else {
+            var->mapped = true;
+        }
+    }
+
+    // Add read rates
+    for (int i = 0; VarRates[i].name != NULL; i++) {
+        VarLayout* var = findVar(VarRates[i].name);
+        if (!var) {
+            printf("ERROR: Read rate for unknown var: %s\n", VarRates[i].name);
+            isValid = false;
+        }
+        else if (var->kind != VAR_DOUBLE && var->kind != VAR_STRING32) {
+            printf("ERROR: Read rate only supported for SimConnect vars: %s\n", var->name);
+            isValid = false;
+        }
+        else if (var->mapped && VarRates[i].rate != RATE_FRAME) {
+            printf("ERROR: Mapped vars must be read every frame: %s\n", var->name);
+            isValid = false;
+        }
+        else {
+            var->rate = VarRates[i].rate;
+        }
+    }
+
+    // Add deadbands
+    deadbandCount = 0;
+    for (int i = 0; VarDeadbands[i].name != NULL; i++) {
+        VarLayout* var = findVar(VarDeadbands[i].name);
+        if (!var) {
+            printf("ERROR: Deadband for unknown var: %s\n", VarDeadbands[i].name);
+            isValid = false;
+        }
+        else if (var->kind != VAR_DOUBLE) {
+            printf("ERROR: Deadband only supported for SimConnect doubles: %s\n", var->name);
+            isValid = false;
+        }
+        else if (var->deadband == 0) {
+            var->deadband = VarDeadbands[i].deadband;
+            deadbandVars[deadbandCount++] = (short)(var - varLayout);
+        }
+    }
+
+    if (sizeof(SimVars) > MaxWords * sizeof(double)) {
+        printf("ERROR: SimVars is too big for diff kernel - Increase MaxWords\n");
+        return false;
+    }
+
+    wordCount = sizeof(SimVars) / sizeof(double);
+    wordVar[0] = -1;
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        for (int word = var->offset / 8; word < (var->offset + var->size) / 8 && word < wordCount; word++) {
+            wordVar[word] = i;
+        }
+    }
+
+    if (offset != sizeof(SimVars)) {
+        printf("ERROR: SimVarDefs has %d bytes of vars but SimVars is %d bytes\n", offset, (int)sizeof(SimVars));
+        isValid = false;
+    }
+
+    return isValid;
+}
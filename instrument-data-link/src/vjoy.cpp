@@ -1,10 +1,11 @@
 #include "vjoy.h"
 #include "simvarDefs.h"
+#include "vjoyPresses.h"
 
 #ifdef vJoyFallback
 
-#include "..\..\vJoy_SDK\inc\public.h"
-#include "..\..\vJoy_SDK\inc\vjoyinterface.h"
+#include "../../vJoy_SDK/inc/public.h"
+#include "../../vJoy_SDK/inc/vjoyinterface.h"
 
 const char* VJOY_CONFIG_EXE = "C:\\Program Files\\vJoy\\x64\\vJoyConf.exe (Run as Admin)";
 
@@ -14,6 +15,11 @@ int vJoyRetry = 0;
 int vJoyConfiguredButtons;
 int vJoyAxisValue = -1;
 
+void vJoySetButton(int button, bool down)
+{
+    SetBtn(down, vJoyDeviceId, button);
+}
+
 void vJoyInit()
 {
     if (vJoyInitialised || vJoyRetry > 10) {
@@ -74,9 +80,15 @@ void vJoyInit()
 
     ResetButtons(vJoyDeviceId);
     ResetVJD(vJoyDeviceId);
+    vJoyPressesInit(vJoySetButton);
     vJoyInitialised = true;
 }
 
+/// <summary>
+/// Press the button now and release it VJoyPressMillis later (see
+/// vjoyPresses.h). Doesn't wait for the release so presses of different
+/// buttons can overlap.
+/// </summary>
 void vJoyButtonPress(int eventId)
 {
     if (!vJoyInitialised) {
@@ -101,11 +113,9 @@ void vJoyButtonPress(int eventId)
         return;
     }
 
-    // Press and release joystick button
+    // Press joystick button
     //printf("Press vJoy button %d\n", button);
-    SetBtn(true, vJoyDeviceId, button);
-    Sleep(60);
-    SetBtn(false, vJoyDeviceId, button);
+    queueVJoyPress(button, GetTickCount64());
 }
 
 void vJoySetAxis(int value) {
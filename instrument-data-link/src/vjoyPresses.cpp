@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include "vjoyPresses.h"
+#include "timerWheel.h"
+
+enum LATE_ACTION {
+    LATE_NONE,
+    LATE_RELEASE,
+    LATE_PRESS
+};
+
+VJoySetButton vJoyBackend = NULL;
+
+// Presses of each button that haven't finished yet (including the one
+// that is currently down)
+int vJoyPending[VJoyButtonCount];
+
+// What to do on a later tick for a button that couldn't get a timer
+LATE_ACTION vJoyLate[VJoyButtonCount];
+unsigned long long vJoyLateDue[VJoyButtonCount];
+int vJoyLateCount = 0;
+
+static void releaseButton(int button);
+static void pressButton(int button);
+
+/// <summary>
+/// Do action after delayMillis. If there are too many timers waiting
+/// do it on the next tick instead rather than straight away, which
+/// would make the press too short for the game to notice.
+/// </summary>
+static void scheduleAction(unsigned long long now, unsigned long delayMillis, LATE_ACTION action, int button)
+{
+    TimerCallback callback = action == LATE_RELEASE ? releaseButton : pressButton;
+
+    if (!scheduleTimer(now, delayMillis, callback, button)) {
+        vJoyLate[button] = action;
+        vJoyLateDue[button] = now + TimerSlotMillis;
+        vJoyLateCount++;
+    }
+}
+
+static void pressButton(int button)
+{
+    vJoyBackend(button, true);
+    scheduleAction(timerNow(), VJoyPressMillis, LATE_RELEASE, button);
+}
+
+static void releaseButton(int button)
+{
+    vJoyBackend(button, false);
+    vJoyPending[button]--;
+
+    // Press it again after a gap for the next queued press
+    if (vJoyPending[button] > 0) {
+        scheduleAction(timerNow(), VJoyGapMillis, LATE_PRESS, button);
+    }
+}
+
+/// <summary>
+/// Called by the timer wheel on every tick to do anything that couldn't
+/// get a timer. Returns true if there is still something waiting.
+/// </summary>
+static bool runLateActions(unsigned long long now)
+{
+    if (vJoyLateCount == 0) {
+        return false;
+    }
+
+    for (int button = 0; button < VJoyButtonCount; button++) {
+        LATE_ACTION action = vJoyLate[button];
+        if (action == LATE_NONE || vJoyLateDue[button] > now) {
+            continue;
+        }
+
+        vJoyLate[button] = LATE_NONE;
+        vJoyLateCount--;
+
+        if (action == LATE_RELEASE) {
+            releaseButton(button);
+        }
+        else {
+            pressButton(button);
+        }
+    }
+
+    return vJoyLateCount > 0;
+}
+
+void vJoyPressesInit(VJoySetButton setButton)
+{
+    vJoyBackend = setButton;
+
+    for (int button = 0; button < VJoyButtonCount; button++) {
+        vJoyPending[button] = 0;
+        vJoyLate[button] = LATE_NONE;
+    }
+    vJoyLateCount = 0;
+
+    setTimerTickCallback(runLateActions);
+}
+
+/// <summary>
+/// Press the button now if it is up and release it VJoyPressMillis
+/// later. If it is already down (or waiting to be pressed again) this
+/// press happens once the ones before it have finished, so the game
+/// sees every press rather than one long one.
+/// </summary>
+void queueVJoyPress(int button, unsigned long long now)
+{
+    if (button < 0 || button >= VJoyButtonCount) {
+        printf("Ignored vJoy button %d - out of range\n", button);
+        return;
+    }
+
+    vJoyPending[button]++;
+    if (vJoyPending[button] == 1) {
+        vJoyBackend(button, true);
+        scheduleAction(now, VJoyPressMillis, LATE_RELEASE, button);
+    }
+}
+
+int pendingVJoyPresses(int button)
+{
+    return vJoyPending[button];
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include "writeQueue.h"
+
+// Bounded queue where each slot has a sequence number that says
+// whether it is ready to be written to or read from.
+struct WriteSlot {
+    std::atomic<unsigned int> sequence;
+    WriteCommand command;
+};
+
+WriteSlot writeSlots[WriteQueueSize];
+std::atomic<unsigned int> queuePos;
+unsigned int takePos;   // Only used by the taking thread
+HANDLE queueEvent = NULL;
+LONGLONG ticksPerSecond = 1;
+
+WriteQueueStats writeQueueStats;
+
+void writeQueueInit()
+{
+    for (int i = 0; i < WriteQueueSize; i++) {
+        writeSlots[i].sequence = i;
+    }
+
+    queuePos = 0;
+    takePos = 0;
+
+    writeQueueStats.queued = 0;
+    writeQueueStats.dropped = 0;
+    writeQueueStats.done = 0;
+    writeQueueStats.totalMicros = 0;
+    writeQueueStats.maxMicros = 0;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    ticksPerSecond = freq.QuadPart;
+
+    queueEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+/// <summary>
+/// Signalled whenever a write is queued.
+/// </summary>
+HANDLE writeQueueEvent()
+{
+    return queueEvent;
+}
+
+/// <summary>
+/// Called by any thread. Never waits. Returns false if the queue
+/// is full, in which case the write is dropped.
+/// </summary>
+bool queueWrite(WriteData* writeData, sockaddr_in* addr)
+{
+    unsigned int pos = queuePos.load(std::memory_order_relaxed);
+    WriteSlot* slot;
+
+    while (true) {
+        slot = &writeSlots[pos & (WriteQueueSize - 1)];
+        unsigned int sequence = slot->sequence.load(std::memory_order_acquire);
+        int diff = (int)(sequence - pos);
+
+        if (diff == 0) {
+            // Slot is free so try to claim it
+            if (queuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            if (writeQueueStats.dropped++ == 0) {
+                printf("Write queue is full - Writes are being dropped\n");
+            }
+            return false;
+        }
+        else {
+            // Another thread got there first
+            pos = queuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    slot->command.writeData = *writeData;
+    slot->command.addr = *addr;
+    slot->command.queuedTime = now.QuadPart;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    writeQueueStats.queued++;
+    if (queueEvent) {
+        SetEvent(queueEvent);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Called by the thread that owns SimConnect. Returns false if
+/// there is nothing queued.
+/// </summary>
+bool takeWrite(WriteCommand* command)
+{
+    WriteSlot* slot = &writeSlots[takePos & (WriteQueueSize - 1)];
+    unsigned int sequence = slot->sequence.load(std::memory_order_acquire);
+
+    if ((int)(sequence - (takePos + 1)) < 0) {
+        return false;
+    }
+
+    *command = slot->command;
+    slot->sequence.store(takePos + WriteQueueSize, std::memory_order_release);
+    takePos++;
+    return true;
+}
+
+/// <summary>
+/// Call once the write has been sent to the sim so we know
+/// how long writes are waiting.
+/// </summary>
+void writeDone(WriteCommand* command)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    double micros = (now.QuadPart - command->queuedTime) * 1000000.0 / ticksPerSecond;
+    writeQueueStats.done++;
+    writeQueueStats.totalMicros += micros;
+    if (micros > writeQueueStats.maxMicros) {
+        writeQueueStats.maxMicros = micros;
+    }
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include "deltas.h"
+#include "deltaDecoder.h"
+
+// Pushes frames through snapshotFrame and checks that every panel ends
+// up with exactly the latest frame after applying the v1 or v2 delta
+// it is given. Returns non-zero if anything is wrong.
+
+struct Panel {
+    PANEL_TYPE panelType;
+    bool v2;
+    long baseFrameNo;
+    SimVars vars;
+};
+
+const char* const Aircraft[] = { "Airbus A310-300", "Cessna 152", "", "FlyByWire A320neo (LEAP) Livery" };
+const int AircraftCount = sizeof(Aircraft) / sizeof(Aircraft[0]);
+
+SimVars current;
+unsigned int seed = 1;
+int fullDataCount;
+int failures = 0;
+
+static unsigned int nextRandom()
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+void check(bool ok, const char* test, const char* what)
+{
+    if (!ok) {
+        printf("FAILED %s: %s\n", test, what);
+        failures++;
+    }
+}
+
+/// <summary>
+/// Strings are zero filled after the terminator as that is what both
+/// decoders leave behind.
+/// </summary>
+void setString(char* str, const char* value)
+{
+    memset(str, 0, 32);
+    strncpy(str, value, 31);
+}
+
+/// <summary>
+/// Changes roughly changePercent of the numeric vars by more than their
+/// deadband and every string var if changeStrings is set.
+/// </summary>
+void changeVars(int changePercent, bool changeStrings)
+{
+    for (int i = 0; i < varCount; i++) {
+        VarLayout* var = &varLayout[i];
+        char* varPtr = (char*)&current + var->offset;
+
+        if (var->kind == VAR_STRING32) {
+            if (changeStrings) {
+                setString(varPtr, Aircraft[nextRandom() % AircraftCount]);
+            }
+        }
+        else if ((int)(nextRandom() % 100) < changePercent) {
+            *(double*)varPtr += var->deadband + 1 + nextRandom() % 1000;
+        }
+    }
+}
+
+void reset()
+{
+    memset(&current, 0, sizeof(current));
+    current.connected = 1;
+    for (int i = 0; i < varCount; i++) {
+        if (varLayout[i].kind == VAR_STRING32) {
+            setString((char*)&current + varLayout[i].offset, Aircraft[0]);
+        }
+    }
+
+    fullDataCount = 0;
+    deltasInit(&current);
+}
+
+/// <summary>
+/// What a panel gets when it first connects.
+/// </summary>
+void sendFull(Panel* panel)
+{
+    Frame* frame = latestFrame();
+    memcpy(&panel->vars, &frame->vars, panelDataSize(panel->panelType));
+    panel->baseFrameNo = frame->frameNo;
+    fullDataCount++;
+}
+
+void initPanel(Panel* panel, PANEL_TYPE panelType, bool v2)
+{
+    memset(panel, 0, sizeof(Panel));
+    panel->panelType = panelType;
+    panel->v2 = v2;
+    sendFull(panel);
+}
+
+/// <summary>
+/// Does what the server does when a panel polls, i.e. sends the delta
+/// from the panel's baseline or full data if there isn't one or it
+/// wouldn't be any smaller. Then checks the panel has the latest frame.
+/// </summary>
+void poll(Panel* panel, const char* test)
+{
+    Frame* frame = latestFrame();
+    long dataSize = panelDataSize(panel->panelType);
+    long deltaSize = 0;
+    const char* delta;
+
+    if (panel->v2) {
+        delta = getDeltaV2(panel->baseFrameNo, panel->panelType, &deltaSize);
+    }
+    else {
+        delta = getDelta(panel->baseFrameNo, panel->panelType, &deltaSize);
+    }
+
+    if (!delta || deltaSize >= dataSize) {
+        sendFull(panel);
+    }
+    else {
+        long frameNo = 0;
+        bool ok;
+        if (panel->v2) {
+            ok = applyDeltaV2(delta, deltaSize, &panel->vars, &frameNo);
+            check(frameNo == frame->frameNo, test, "v2 delta has the wrong frame number");
+        }
+        else {
+            ok = applyDelta(delta, deltaSize, &panel->vars);
+        }
+        check(ok, test, "delta didn't decode");
+        panel->baseFrameNo = frame->frameNo;
+    }
+
+    if (memcmp(&panel->vars, &frame->vars, dataSize) != 0) {
+        char what[128];
+        sprintf(what, "%s (%s) doesn't match the latest frame", panelName(panel->panelType), panel->v2 ? "v2" : "v1");
+        check(false, test, what);
+    }
+}
+
+/// <summary>
+/// One panel of each type for each delta version.
+/// </summary>
+void initPanels(Panel* panels)
+{
+    for (int panel = INSTRUMENT_PANEL; panel <= LIGHTS_PANEL; panel++) {
+        initPanel(&panels[panel * 2], (PANEL_TYPE)panel, false);
+        initPanel(&panels[panel * 2 + 1], (PANEL_TYPE)panel, true);
+    }
+}
+
+const int PanelCount = (LIGHTS_PANEL + 1) * 2;
+
+void testEveryFrame()
+{
+    const char* test = "every frame";
+    reset();
+    Panel panels[PanelCount];
+    initPanels(panels);
+
+    for (int frame = 0; frame < 100; frame++) {
+        changeVars(10, frame % 7 == 0);
+        snapshotFrame(&current);
+        for (int i = 0; i < PanelCount; i++) {
+            poll(&panels[i], test);
+        }
+    }
+
+    check(fullDataCount == PanelCount, test, "expected full data only when the panels connected");
+}
+
+void testStrings()
+{
+    const char* test = "strings";
+    reset();
+    Panel panels[PanelCount];
+    initPanels(panels);
+
+    // Every string gets shorter, longer then empty and nothing else changes
+    for (int i = 1; i < AircraftCount; i++) {
+        for (int j = 0; j < varCount; j++) {
+            if (varLayout[j].kind == VAR_STRING32) {
+                setString((char*)&current + varLayout[j].offset, Aircraft[i]);
+            }
+        }
+        snapshotFrame(&current);
+        for (int i = 0; i < PanelCount; i++) {
+            poll(&panels[i], test);
+        }
+    }
+}
+
+/// <summary>
+/// Panels that poll every few frames get the changes from every frame
+/// they missed merged together, including one that is further behind
+/// than the delta cache.
+/// </summary>
+void testBehind()
+{
+    const char* test = "behind";
+    const int pollFrames[] = { 2, 5, FrameHistory - 1, FrameHistory, 40 };
+    const int rateCount = sizeof(pollFrames) / sizeof(pollFrames[0]);
+
+    reset();
+    Panel panels[rateCount][PanelCount];
+    for (int rate = 0; rate < rateCount; rate++) {
+        initPanels(panels[rate]);
+    }
+
+    for (int frame = 1; frame <= 200; frame++) {
+        changeVars(1, frame % 11 == 0);
+        snapshotFrame(&current);
+        for (int rate = 0; rate < rateCount; rate++) {
+            if (frame % pollFrames[rate] == 0) {
+                for (int i = 0; i < PanelCount; i++) {
+                    poll(&panels[rate][i], test);
+                }
+            }
+        }
+    }
+
+    check(fullDataCount == rateCount * PanelCount, test, "expected full data only when the panels connected");
+}
+
+void testTooFarBehind()
+{
+    const char* test = "too far behind";
+    reset();
+    long baseFrameNo = latestFrame()->frameNo;
+
+    for (int frame = 0; frame < ChangeHistory; frame++) {
+        changeVars(1, false);
+        snapshotFrame(&current);
+    }
+
+    long deltaSize = 0;
+    check(getDelta(baseFrameNo, INSTRUMENT_PANEL, &deltaSize) == NULL, test, "expected no v1 delta");
+    check(getDeltaV2(baseFrameNo, INSTRUMENT_PANEL, &deltaSize) == NULL, test, "expected no v2 delta");
+    check(getDelta(baseFrameNo + 1, INSTRUMENT_PANEL, &deltaSize) != NULL, test, "expected a v1 delta at the limit");
+}
+
+/// <summary>
+/// When every var changes a v2 delta is no smaller than full data so
+/// the panel must be sent full data instead.
+/// </summary>
+void testV2Overflow()
+{
+    const char* test = "v2 overflow";
+    reset();
+    Panel panels[PanelCount];
+    initPanels(panels);
+
+    long baseFrameNo = latestFrame()->frameNo;
+    changeVars(100, false);
+    for (int i = 0; i < varCount; i++) {
+        if (varLayout[i].kind == VAR_STRING32) {
+            setString((char*)&current + varLayout[i].offset, "0123456789012345678901234567890");
+        }
+    }
+    snapshotFrame(&current);
+
+    long deltaSize = 0;
+    check(getDeltaV2(baseFrameNo, INSTRUMENT_PANEL, &deltaSize) != NULL, test, "expected a v2 delta");
+    check(deltaSize == MaxDeltaV2Size, test, "expected the v2 delta to be too big");
+
+    for (int i = 0; i < PanelCount; i++) {
+        poll(&panels[i], test);
+    }
+    check(panels[INSTRUMENT_PANEL * 2].baseFrameNo == latestFrame()->frameNo, test, "v1 panel wasn't updated");
+    check(fullDataCount > PanelCount, test, "expected full data for the v2 instrument panel");
+
+    // Back to deltas on the next frame
+    int fullDataBefore = fullDataCount;
+    changeVars(10, false);
+    snapshotFrame(&current);
+    for (int i = 0; i < PanelCount; i++) {
+        poll(&panels[i], test);
+    }
+    check(fullDataCount == fullDataBefore, test, "expected deltas after the overflow");
+}
+
+int main(int argc, char* argv[])
+{
+    if (!varLayoutInit()) {
+        printf("FAILED: SimVarDefs doesn't match SimVars\n");
+        return 1;
+    }
+
+    testEveryFrame();
+    testStrings();
+    testBehind();
+    testTooFarBehind();
+    testV2Overflow();
+
+    if (failures == 0) {
+        printf("All delta tests passed\n");
+        return 0;
+    }
+
+    printf("%d delta checks failed\n", failures);
+    return 1;
+}
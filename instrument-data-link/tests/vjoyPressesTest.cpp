@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include "timerWheel.h"
+#include "vjoyPresses.h"
+
+// Checks the vJoy press/release cycles against a fake vJoy device and a
+// fake clock. Returns non-zero if anything is wrong.
+
+struct ButtonEvent {
+    unsigned long long millis;
+    int button;
+    bool down;
+};
+
+const int MaxEvents = 64;
+
+ButtonEvent events[MaxEvents];
+int eventCount;
+unsigned long long clockMillis;
+int failures = 0;
+
+void fakeSetButton(int button, bool down)
+{
+    if (eventCount < MaxEvents) {
+        events[eventCount].millis = clockMillis;
+        events[eventCount].button = button;
+        events[eventCount].down = down;
+        eventCount++;
+    }
+}
+
+void noTimer(int arg)
+{
+}
+
+void reset()
+{
+    clockMillis = 1000;
+    eventCount = 0;
+    timerWheelInit(clockMillis);
+    vJoyPressesInit(fakeSetButton);
+}
+
+/// <summary>
+/// Advance the fake clock a millisecond at a time until
+/// nothing is waiting, or millis has passed.
+/// </summary>
+void runFor(unsigned long millis)
+{
+    unsigned long long end = clockMillis + millis;
+    while (clockMillis < end) {
+        clockMillis++;
+        runTimers(clockMillis);
+    }
+}
+
+void check(bool ok, const char* test, const char* what)
+{
+    if (!ok) {
+        printf("FAILED %s: %s\n", test, what);
+        for (int i = 0; i < eventCount; i++) {
+            printf("    %llu button %d %s\n", events[i].millis, events[i].button, events[i].down ? "down" : "up");
+        }
+        failures++;
+    }
+}
+
+void testSinglePress()
+{
+    const char* test = "single press";
+    reset();
+    queueVJoyPress(3, clockMillis);
+    runFor(500);
+
+    check(eventCount == 2, test, "expected one down and one up");
+    check(events[0].down && !events[1].down, test, "expected down then up");
+    check(events[1].millis - events[0].millis >= VJoyPressMillis, test, "released too soon");
+    check(pendingVJoyPresses(3) == 0, test, "presses still pending");
+}
+
+void testRepeatedPress()
+{
+    const char* test = "repeated press";
+    reset();
+
+    // Pressed three times before the first press is released
+    queueVJoyPress(5, clockMillis);
+    runFor(10);
+    queueVJoyPress(5, clockMillis);
+    queueVJoyPress(5, clockMillis);
+    check(pendingVJoyPresses(5) == 3, test, "expected three pending presses");
+    runFor(1000);
+
+    check(eventCount == 6, test, "expected three separate presses");
+    for (int i = 0; i < eventCount; i++) {
+        check(events[i].down == (i % 2 == 0), test, "expected alternating down and up");
+        if (i > 0) {
+            unsigned long minMillis = events[i].down ? VJoyGapMillis : VJoyPressMillis;
+            check(events[i].millis - events[i - 1].millis >= minMillis, test, "press or gap too short");
+        }
+    }
+    check(pendingVJoyPresses(5) == 0, test, "presses still pending");
+}
+
+void testDifferentButtons()
+{
+    const char* test = "different buttons";
+    reset();
+    queueVJoyPress(1, clockMillis);
+    queueVJoyPress(2, clockMillis);
+    runFor(500);
+
+    // Both go down straight away without waiting for each other
+    check(eventCount == 4, test, "expected two presses");
+    check(events[0].down && events[1].down, test, "expected both down together");
+}
+
+void testWheelFull()
+{
+    const char* test = "wheel full";
+    reset();
+    while (scheduleTimer(clockMillis, 100000, noTimer, 0)) {
+    }
+
+    queueVJoyPress(4, clockMillis);
+    check(eventCount == 1 && events[0].down, test, "expected the button down");
+
+    // The same tick mustn't release it
+    runTimers(clockMillis);
+    check(eventCount == 1, test, "released in the same tick");
+    check(nextTimerMillis(clockMillis) <= (unsigned long)TimerSlotMillis, test, "expected a wakeup on the next tick");
+
+    runFor(TimerSlotMillis);
+    check(eventCount == 2 && !events[1].down, test, "expected a release on the next tick");
+    check(events[1].millis > events[0].millis, test, "released straight away");
+    check(pendingVJoyPresses(4) == 0, test, "presses still pending");
+}
+
+int main(int argc, char* argv[])
+{
+    testSinglePress();
+    testRepeatedPress();
+    testDifferentButtons();
+    testWheelFull();
+
+    if (failures == 0) {
+        printf("All vJoy press tests passed\n");
+        return 0;
+    }
+
+    printf("%d vJoy press checks failed\n", failures);
+    return 1;
+}